@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/connect_rate.dir/src/connect_rate.c.o"
+  "CMakeFiles/connect_rate.dir/src/connect_rate.c.o.d"
+  "connect_rate"
+  "connect_rate.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/connect_rate.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/gettimeofday.dir/src/gettimeofday.c.o"
+  "CMakeFiles/gettimeofday.dir/src/gettimeofday.c.o.d"
+  "gettimeofday"
+  "gettimeofday.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/gettimeofday.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
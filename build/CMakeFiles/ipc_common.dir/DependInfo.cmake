@@ -0,0 +1,34 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/bench.c" "CMakeFiles/ipc_common.dir/src/bench.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/bench.c.o.d"
+  "/root/repo/src/copy.c" "CMakeFiles/ipc_common.dir/src/copy.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/copy.c.o.d"
+  "/root/repo/src/inet_family.c" "CMakeFiles/ipc_common.dir/src/inet_family.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/inet_family.c.o.d"
+  "/root/repo/src/memory.c" "CMakeFiles/ipc_common.dir/src/memory.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/memory.c.o.d"
+  "/root/repo/src/netns.c" "CMakeFiles/ipc_common.dir/src/netns.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/netns.c.o.d"
+  "/root/repo/src/noise.c" "CMakeFiles/ipc_common.dir/src/noise.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/noise.c.o.d"
+  "/root/repo/src/payload.c" "CMakeFiles/ipc_common.dir/src/payload.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/payload.c.o.d"
+  "/root/repo/src/perf.c" "CMakeFiles/ipc_common.dir/src/perf.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/perf.c.o.d"
+  "/root/repo/src/pipe_channel.c" "CMakeFiles/ipc_common.dir/src/pipe_channel.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/pipe_channel.c.o.d"
+  "/root/repo/src/pipeline.c" "CMakeFiles/ipc_common.dir/src/pipeline.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/pipeline.c.o.d"
+  "/root/repo/src/ready_pipe.c" "CMakeFiles/ipc_common.dir/src/ready_pipe.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/ready_pipe.c.o.d"
+  "/root/repo/src/realtime.c" "CMakeFiles/ipc_common.dir/src/realtime.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/realtime.c.o.d"
+  "/root/repo/src/stats.c" "CMakeFiles/ipc_common.dir/src/stats.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/stats.c.o.d"
+  "/root/repo/src/tcp_tuning.c" "CMakeFiles/ipc_common.dir/src/tcp_tuning.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/tcp_tuning.c.o.d"
+  "/root/repo/src/unix_socket.c" "CMakeFiles/ipc_common.dir/src/unix_socket.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/unix_socket.c.o.d"
+  "/root/repo/src/workload.c" "CMakeFiles/ipc_common.dir/src/workload.c.o" "gcc" "CMakeFiles/ipc_common.dir/src/workload.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,41 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/ipc_common.dir/src/bench.c.o"
+  "CMakeFiles/ipc_common.dir/src/bench.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/copy.c.o"
+  "CMakeFiles/ipc_common.dir/src/copy.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/inet_family.c.o"
+  "CMakeFiles/ipc_common.dir/src/inet_family.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/memory.c.o"
+  "CMakeFiles/ipc_common.dir/src/memory.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/netns.c.o"
+  "CMakeFiles/ipc_common.dir/src/netns.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/noise.c.o"
+  "CMakeFiles/ipc_common.dir/src/noise.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/payload.c.o"
+  "CMakeFiles/ipc_common.dir/src/payload.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/perf.c.o"
+  "CMakeFiles/ipc_common.dir/src/perf.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/pipe_channel.c.o"
+  "CMakeFiles/ipc_common.dir/src/pipe_channel.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/pipeline.c.o"
+  "CMakeFiles/ipc_common.dir/src/pipeline.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/ready_pipe.c.o"
+  "CMakeFiles/ipc_common.dir/src/ready_pipe.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/realtime.c.o"
+  "CMakeFiles/ipc_common.dir/src/realtime.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/stats.c.o"
+  "CMakeFiles/ipc_common.dir/src/stats.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/tcp_tuning.c.o"
+  "CMakeFiles/ipc_common.dir/src/tcp_tuning.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/unix_socket.c.o"
+  "CMakeFiles/ipc_common.dir/src/unix_socket.c.o.d"
+  "CMakeFiles/ipc_common.dir/src/workload.c.o"
+  "CMakeFiles/ipc_common.dir/src/workload.c.o.d"
+  "libipc_common.a"
+  "libipc_common.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ipc_common.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
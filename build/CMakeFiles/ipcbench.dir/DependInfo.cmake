@@ -0,0 +1,24 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/ipcbench.c" "CMakeFiles/ipcbench.dir/src/ipcbench.c.o" "gcc" "CMakeFiles/ipcbench.dir/src/ipcbench.c.o.d"
+  "/root/repo/src/transport_posix.c" "CMakeFiles/ipcbench.dir/src/transport_posix.c.o" "gcc" "CMakeFiles/ipcbench.dir/src/transport_posix.c.o.d"
+  "/root/repo/src/transport_socket.c" "CMakeFiles/ipcbench.dir/src/transport_socket.c.o" "gcc" "CMakeFiles/ipcbench.dir/src/transport_socket.c.o.d"
+  "/root/repo/src/transport_stream.c" "CMakeFiles/ipcbench.dir/src/transport_stream.c.o" "gcc" "CMakeFiles/ipcbench.dir/src/transport_stream.c.o.d"
+  "/root/repo/src/transport_sysv.c" "CMakeFiles/ipcbench.dir/src/transport_sysv.c.o" "gcc" "CMakeFiles/ipcbench.dir/src/transport_sysv.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/build/CMakeFiles/ipc_common.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
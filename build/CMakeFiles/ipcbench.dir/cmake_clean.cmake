@@ -0,0 +1,19 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/ipcbench.dir/src/ipcbench.c.o"
+  "CMakeFiles/ipcbench.dir/src/ipcbench.c.o.d"
+  "CMakeFiles/ipcbench.dir/src/transport_posix.c.o"
+  "CMakeFiles/ipcbench.dir/src/transport_posix.c.o.d"
+  "CMakeFiles/ipcbench.dir/src/transport_socket.c.o"
+  "CMakeFiles/ipcbench.dir/src/transport_socket.c.o.d"
+  "CMakeFiles/ipcbench.dir/src/transport_stream.c.o"
+  "CMakeFiles/ipcbench.dir/src/transport_stream.c.o.d"
+  "CMakeFiles/ipcbench.dir/src/transport_sysv.c.o"
+  "CMakeFiles/ipcbench.dir/src/transport_sysv.c.o.d"
+  "ipcbench"
+  "ipcbench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ipcbench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
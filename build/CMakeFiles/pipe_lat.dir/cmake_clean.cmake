@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/pipe_lat.dir/src/pipe_lat.c.o"
+  "CMakeFiles/pipe_lat.dir/src/pipe_lat.c.o.d"
+  "pipe_lat"
+  "pipe_lat.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/pipe_lat.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
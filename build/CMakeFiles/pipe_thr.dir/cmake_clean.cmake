@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/pipe_thr.dir/src/pipe_thr.c.o"
+  "CMakeFiles/pipe_thr.dir/src/pipe_thr.c.o.d"
+  "pipe_thr"
+  "pipe_thr.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/pipe_thr.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
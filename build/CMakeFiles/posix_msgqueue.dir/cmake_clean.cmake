@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/posix_msgqueue.dir/src/posix_msgqueue.c.o"
+  "CMakeFiles/posix_msgqueue.dir/src/posix_msgqueue.c.o.d"
+  "posix_msgqueue"
+  "posix_msgqueue.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/posix_msgqueue.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
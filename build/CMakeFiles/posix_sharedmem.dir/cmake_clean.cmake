@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/posix_sharedmem.dir/src/posix_sharedmem.c.o"
+  "CMakeFiles/posix_sharedmem.dir/src/posix_sharedmem.c.o.d"
+  "posix_sharedmem"
+  "posix_sharedmem.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/posix_sharedmem.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/posix_sharedmem_multi.dir/src/posix_sharedmem_multi.c.o"
+  "CMakeFiles/posix_sharedmem_multi.dir/src/posix_sharedmem_multi.c.o.d"
+  "posix_sharedmem_multi"
+  "posix_sharedmem_multi.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/posix_sharedmem_multi.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/shm_thr.dir/src/shm_thr.c.o"
+  "CMakeFiles/shm_thr.dir/src/shm_thr.c.o.d"
+  "shm_thr"
+  "shm_thr.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/shm_thr.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/sysv_msgqueue.dir/src/sysv_msgqueue.c.o"
+  "CMakeFiles/sysv_msgqueue.dir/src/sysv_msgqueue.c.o.d"
+  "sysv_msgqueue"
+  "sysv_msgqueue.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/sysv_msgqueue.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
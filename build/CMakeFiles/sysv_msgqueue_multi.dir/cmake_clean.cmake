@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/sysv_msgqueue_multi.dir/src/sysv_msgqueue_multi.c.o"
+  "CMakeFiles/sysv_msgqueue_multi.dir/src/sysv_msgqueue_multi.c.o.d"
+  "sysv_msgqueue_multi"
+  "sysv_msgqueue_multi.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/sysv_msgqueue_multi.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/sysv_semaphore.dir/src/sysv_semaphore.c.o"
+  "CMakeFiles/sysv_semaphore.dir/src/sysv_semaphore.c.o.d"
+  "sysv_semaphore"
+  "sysv_semaphore.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/sysv_semaphore.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/sysv_semaphore_multi.dir/src/sysv_semaphore_multi.c.o"
+  "CMakeFiles/sysv_semaphore_multi.dir/src/sysv_semaphore_multi.c.o.d"
+  "sysv_semaphore_multi"
+  "sysv_semaphore_multi.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/sysv_semaphore_multi.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/tcp_local_lat.dir/src/tcp_local_lat.c.o"
+  "CMakeFiles/tcp_local_lat.dir/src/tcp_local_lat.c.o.d"
+  "tcp_local_lat"
+  "tcp_local_lat.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/tcp_local_lat.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/tcp_remote_lat.dir/src/tcp_remote_lat.c.o"
+  "CMakeFiles/tcp_remote_lat.dir/src/tcp_remote_lat.c.o.d"
+  "tcp_remote_lat"
+  "tcp_remote_lat.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/tcp_remote_lat.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
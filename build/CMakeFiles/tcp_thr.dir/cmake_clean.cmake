@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/tcp_thr.dir/src/tcp_thr.c.o"
+  "CMakeFiles/tcp_thr.dir/src/tcp_thr.c.o.d"
+  "tcp_thr"
+  "tcp_thr.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/tcp_thr.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
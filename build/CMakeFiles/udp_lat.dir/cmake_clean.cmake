@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/udp_lat.dir/src/udp_lat.c.o"
+  "CMakeFiles/udp_lat.dir/src/udp_lat.c.o.d"
+  "udp_lat"
+  "udp_lat.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/udp_lat.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/unix_lat.dir/src/unix_lat.c.o"
+  "CMakeFiles/unix_lat.dir/src/unix_lat.c.o.d"
+  "unix_lat"
+  "unix_lat.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/unix_lat.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/unix_thr.dir/src/unix_thr.c.o"
+  "CMakeFiles/unix_thr.dir/src/unix_thr.c.o.d"
+  "unix_thr"
+  "unix_thr.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/unix_thr.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
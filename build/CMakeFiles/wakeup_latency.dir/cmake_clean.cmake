@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/wakeup_latency.dir/src/wakeup_latency.c.o"
+  "CMakeFiles/wakeup_latency.dir/src/wakeup_latency.c.o.d"
+  "wakeup_latency"
+  "wakeup_latency.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/wakeup_latency.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
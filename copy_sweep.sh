@@ -0,0 +1,48 @@
+#!/bin/bash
+
+# Run shm_thr with every copy kernel over a range of frame sizes and
+# report the throughput and write time of each relative to memcpy.
+
+set -e
+
+KERNELS="memcpy movsb nt-avx2 nt-avx512 nt-neon inplace"
+SIZES="65536 262144 1048576 4194304 16777216 67108864"
+BYTES=4294967296
+RUNS=5
+OUT=copy_sweep.csv
+SWEEP_OPTIONS='k KERNELS "<kernels>" copy kernels
+s SIZES "<sizes>" frame sizes in octets
+b BYTES <bytes> octets handed over per run
+r RUNS <runs> measured runs per point
+o OUT <file> csv output'
+
+. "$(dirname "$0")/sweep_lib.sh"
+sweep_parse_options "$@"
+OUT=$(sweep_path "$OUT")
+
+sweep_build shm_thr
+
+echo "kernel,size,throughput_mbps,write_ns,throughput_change" > "$OUT"
+printf "%-10s %10s %12s %12s %8s\n" kernel size "thr (Mb/s)" "write (ns)" change
+
+for size in $SIZES; do
+    count=$((BYTES / size))
+    [ "$count" -gt 0 ] || count=1
+    base=""
+    for kernel in $KERNELS; do
+        # kernels the CPU does not have are rejected, skip them
+        result=$(./shm_thr --runs="$RUNS" --copy="$kernel" "$size" "$count" \
+                     2> /dev/null || true)
+        thr=$(echo "$result" | sweep_metric "throughput:.*Mb/s")
+        [ -n "$thr" ] || continue
+        write=$(echo "$result" | sweep_metric "write time:")
+        [ "$kernel" != memcpy ] || base=$thr
+        thr_change=$(sweep_change "$thr" "$base")
+
+        echo "$kernel,$size,$thr,$write,$thr_change" >> "$OUT"
+        printf "%-10s %10s %12s %12s %8s\n" "$kernel" "$size" "$thr" "$write" \
+            "$thr_change"
+    done
+done
+
+printf "\nwrote %s\n" "$OUT"
@@ -0,0 +1,71 @@
+#!/bin/bash
+
+# Run pipe_lat and pipe_thr over anonymous pipes and named FIFOs, a range
+# of F_SETPIPE_SZ capacities and byte stream or O_DIRECT packet mode, and
+# report the median latency and throughput of every combination relative
+# to an anonymous pipe of default capacity.
+
+set -e
+
+SIZES="64 1024 4096 65536"
+CAPACITIES="default 4096 16384 262144 1048576"
+COUNT=100000
+RUNS=5
+OUT=pipe_sweep.csv
+SWEEP_OPTIONS='s SIZES "<sizes>" message sizes in octets
+p CAPACITIES "<capacities>" pipe capacities in octets
+c COUNT <count> messages/roundtrips per run
+r RUNS <runs> measured runs per point
+o OUT <file> csv output'
+
+. "$(dirname "$0")/sweep_lib.sh"
+sweep_parse_options "$@"
+OUT=$(sweep_path "$OUT")
+
+if [[ "$OSTYPE" == "darwin"* ]]; then
+    echo "pipe capacity and packet mode need Linux"
+    exit 1
+fi
+
+sweep_build pipe_lat pipe_thr
+
+MAX=$(cat /proc/sys/fs/pipe-max-size 2>/dev/null || echo 1048576)
+
+# Result of a benchmark: binary options size metric-pattern
+measure() {
+    ./$1 --runs="$RUNS" $2 "$3" "$COUNT" 2> /dev/null | sweep_metric "$4"
+}
+
+echo "kind,capacity,mode,size,latency_ns,throughput_mbps,latency_change,throughput_change" > "$OUT"
+printf "%-9s %-9s %-6s %-7s %10s %8s %12s %8s\n" kind capacity mode size "lat (ns)" change "thr (Mb/s)" change
+
+for size in $SIZES; do
+    base_lat=""
+    base_thr=""
+    for kind in anonymous fifo; do
+        for capacity in $CAPACITIES; do
+            [ "$capacity" = default ] || [ "$capacity" -le "$MAX" ] || continue
+            for mode in stream packet; do
+                opts=""
+                [ $kind = fifo ] && opts+=" --fifo"
+                [ "$capacity" = default ] || opts+=" --pipe-size=$capacity"
+                [ $mode = packet ] && opts+=" --packet"
+
+                lat=$(measure pipe_lat "$opts" "$size" "latency:")
+                thr=$(measure pipe_thr "$opts" "$size" "throughput:.*Mb/s")
+                if [ -z "$base_lat" ]; then
+                    base_lat=$lat
+                    base_thr=$thr
+                fi
+                lat_change=$(sweep_change "$lat" "$base_lat")
+                thr_change=$(sweep_change "$thr" "$base_thr")
+
+                echo "$kind,$capacity,$mode,$size,$lat,$thr,$lat_change,$thr_change" >> "$OUT"
+                printf "%-9s %-9s %-6s %-7s %10s %8s %12s %8s\n" $kind $capacity $mode \
+                    "$size" "${lat:--}" "$lat_change" "${thr:--}" "$thr_change"
+            done
+        done
+    done
+done
+
+printf "\nwrote %s\n" "$OUT"
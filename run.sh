@@ -23,6 +23,10 @@ echo
 echo "UNIX Domain Socket:"
 ./unix_lat 256 10000
 
+echo
+echo "TCP connection setup and teardown:"
+./connect_rate 10000
+
 echo
 echo "gettimeofday()"
 ./gettimeofday 10000
@@ -56,6 +60,10 @@ echo
 echo "POSIX Shared memory with POSIX semaphore using multiple processes"
 ./posix_sharedmem_multi 10000 100
 
+echo
+echo "Large frames through POSIX shared memory"
+./shm_thr 4194304 1000
+
 echo
 echo "POSIX message queue"
 ./posix_msgqueue 256 10000
@@ -0,0 +1,354 @@
+/*
+    Command line options shared by all benchmarks
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "noise.h"
+#include "realtime.h"
+#include "timing.h"
+
+struct bench_options bench_opts = {
+    .runs = 1,
+    .warmup_runs = 0,
+    .warmup_iterations = 0,
+    .warmup_ns = 0,
+    .mlock = 0,
+    .perf = 0,
+    .pages = PAGES_DEFAULT,
+    .hugetlbfs = NULL,
+};
+
+/* Shared with forked peers, which cannot know in advance how many
+ * iterations a duration based warmup takes */
+struct warmup_state {
+    volatile int64_t iterations; /* -1 until the warmup phase ended */
+};
+
+static struct warmup_state *warmup;
+static int64_t warmup_start;
+static int64_t warmup_first;
+
+static void remove_args(int *argc, char *argv[], int at, int n)
+{
+    for (int i = at; i + n <= *argc; i++) {
+        argv[i] = argv[i + n];
+    }
+    *argc -= n;
+}
+
+const char *bench_take_option(int *argc, char *argv[], const char *name)
+{
+    size_t len = strlen(name);
+
+    for (int i = 1; i < *argc; i++) {
+        const char *arg = argv[i];
+        const char *value;
+
+        if (strcmp(arg, "--") == 0) {
+            break;
+        }
+        if (strncmp(arg, "--", 2) != 0 || strncmp(arg + 2, name, len) != 0) {
+            continue;
+        }
+        if (arg[2 + len] == '=') {
+            value = arg + 3 + len;
+            remove_args(argc, argv, i, 1);
+            return value;
+        }
+        if (arg[2 + len] == '\0') {
+            /* a bare flag has an empty value */
+            remove_args(argc, argv, i, 1);
+            return "";
+        }
+    }
+    return NULL;
+}
+
+int bench_take_int_option(int *argc, char *argv[], const char *name,
+                          int min, int *out)
+{
+    const char *value = bench_take_option(argc, argv, name);
+    char *end;
+    long v;
+
+    if (value == NULL) {
+        return 0;
+    }
+    v = strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || v < min) {
+        fprintf(stderr, "bad value for --%s: '%s'\n", name, value);
+        return -1;
+    }
+    *out = (int)v;
+    return 0;
+}
+
+/* "10000" is a number of iterations, "500ms", "2s" or "100us" a duration */
+static int parse_warmup_option(int *argc, char *argv[])
+{
+    const char *value = bench_take_option(argc, argv, "warmup");
+    char *end;
+    long long v;
+
+    if (value == NULL) {
+        return 0;
+    }
+    v = strtoll(value, &end, 10);
+    if (*value == '\0' || v < 0) {
+        goto bad;
+    }
+    if (*end == '\0') {
+        bench_opts.warmup_iterations = v;
+    } else if (strcmp(end, "s") == 0) {
+        bench_opts.warmup_ns = v * 1000000000;
+    } else if (strcmp(end, "ms") == 0) {
+        bench_opts.warmup_ns = v * 1000000;
+    } else if (strcmp(end, "us") == 0) {
+        bench_opts.warmup_ns = v * 1000;
+    } else {
+        goto bad;
+    }
+
+    if (bench_opts.warmup_iterations || bench_opts.warmup_ns) {
+        warmup = mmap(NULL, sizeof(*warmup), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (warmup == MAP_FAILED) {
+            perror("mmap");
+            return -1;
+        }
+        warmup->iterations = bench_opts.warmup_ns ? -1
+                             : bench_opts.warmup_iterations;
+    }
+    return 0;
+
+bad:
+    fprintf(stderr, "bad value for --warmup: '%s'\n", value);
+    return -1;
+}
+
+static int no_buffers;
+
+void bench_no_buffers(void)
+{
+    no_buffers = 1;
+}
+
+static int parse_pages_option(int *argc, char *argv[])
+{
+    const char *value = bench_take_option(argc, argv, "pages");
+
+    if (value == NULL || strcmp(value, "default") == 0) {
+        bench_opts.pages = PAGES_DEFAULT;
+    } else if (strcmp(value, "thp") == 0) {
+        bench_opts.pages = PAGES_THP;
+    } else if (strcmp(value, "2m") == 0) {
+        bench_opts.pages = PAGES_2M;
+    } else if (strcmp(value, "1g") == 0) {
+        bench_opts.pages = PAGES_1G;
+    } else {
+        fprintf(stderr, "bad value for --pages: '%s'\n", value);
+        return -1;
+    }
+
+    bench_opts.hugetlbfs = bench_take_option(argc, argv, "hugetlbfs");
+    if (no_buffers && (value != NULL || bench_opts.hugetlbfs != NULL)) {
+        fprintf(stderr, "--pages and --hugetlbfs have no effect, there are "
+                        "no message buffers\n");
+        return -1;
+    }
+    if (bench_opts.hugetlbfs != NULL && bench_opts.pages == PAGES_DEFAULT) {
+        bench_opts.pages = PAGES_2M;
+    }
+    return 0;
+}
+
+int bench_parse_options(int *argc, char *argv[])
+{
+    if (bench_take_int_option(argc, argv, "runs", 1, &bench_opts.runs) ||
+            bench_take_int_option(argc, argv, "warmup-runs", 0,
+                             &bench_opts.warmup_runs) ||
+            parse_warmup_option(argc, argv) ||
+            parse_pages_option(argc, argv) ||
+            noise_parse_options(argc, argv) ||
+            realtime_parse_options(argc, argv)) {
+        return -1;
+    }
+    bench_opts.mlock = bench_take_option(argc, argv, "mlock") != NULL;
+    bench_opts.perf = bench_take_option(argc, argv, "perf") != NULL;
+
+    for (int i = 1; i < *argc; i++) {
+        if (strcmp(argv[i], "--") == 0) {
+            remove_args(argc, argv, i, 1);
+            break;
+        }
+        if (strncmp(argv[i], "--", 2) == 0) {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return -1;
+        }
+    }
+    /* the noise workers keep the default scheduling */
+    return noise_start() || realtime_apply() ? -1 : 0;
+}
+
+const char *bench_usage(void)
+{
+    return "options:\n"
+           "  --runs=N         repeat the measurement N times (default 1)\n"
+           "  --warmup-runs=N  run N discarded repetitions first (default 0)\n"
+           "  --warmup=N|T     warm up for N iterations or a duration T such\n"
+           "                   as 500ms before measuring, and report the cost\n"
+           "  --mlock          lock message buffers and shared regions\n"
+           "  --perf           count cycles, cache misses, context switches\n"
+           "                   etc. per message in every process\n"
+           "  --pages=P        back buffers and shared memory with default,\n"
+           "                   thp (transparent), 2m or 1g (hugetlb) pages\n"
+           "  --hugetlbfs=DIR  take hugetlb shared memory from a file in DIR\n"
+           "                   instead of memfd_create\n"
+           "  --noise=SPEC     run background load alongside the benchmark,\n"
+           "                   SPEC is KIND[:N][@CPU[-CPU]] for N workers of\n"
+           "                   KIND cpu, memory (bandwidth), cache (random\n"
+           "                   writes beyond the LLC) or syscall spread over\n"
+           "                   the CPUs, can be given more than once\n"
+           "  --sched=POLICY   run parent and children under other, batch,\n"
+           "                   idle, fifo, rr or deadline scheduling\n"
+           "  --priority=N     real-time priority for fifo and rr, nice\n"
+           "                   value otherwise\n"
+           "  --deadline=R[:D[:P]] SCHED_DEADLINE runtime, deadline and\n"
+           "                   period in microseconds\n"
+           "  --mlockall       lock all present and future memory\n";
+}
+
+int bench_total_runs(void)
+{
+    return bench_opts.warmup_runs + bench_opts.runs;
+}
+
+int bench_first_run(void)
+{
+    return warmup != NULL ? -1 : 0;
+}
+
+int bench_warmup_continues(int64_t i)
+{
+    int64_t now;
+
+    if (i == 0) {
+        warmup_start = now_ns();
+        return bench_opts.warmup_ns || bench_opts.warmup_iterations;
+    }
+
+    now = now_ns();
+    if (i == 1) {
+        warmup_first = now - warmup_start;
+    }
+
+    if (bench_opts.warmup_ns) {
+        if (warmup->iterations < 0) {
+            if (now - warmup_start < bench_opts.warmup_ns) {
+                return 1;
+            }
+            /* Published one message ahead, so a peer that marks before
+             * its blocking receive already knows the next message is the
+             * first measured one */
+            warmup->iterations = i + 1;
+        }
+        return i < warmup->iterations;
+    }
+    return i < bench_opts.warmup_iterations;
+}
+
+int bench_warmup_done(int run, int64_t iterations, int64_t ns)
+{
+    if (run >= 0) {
+        return 0;
+    }
+    if (iterations > 0) {
+        printf("warmup: %li iterations, first %li ns, average %li ns per iteration\n",
+               (long)iterations, (long)(iterations > 1 ? warmup_first : ns),
+               (long)(ns / iterations));
+    }
+    return 1;
+}
+
+int64_t bench_peer_iterations(int64_t count)
+{
+    int64_t measured = count * bench_total_runs();
+
+    if (warmup == NULL) {
+        return measured;
+    }
+    if (warmup->iterations < 0) {
+        return INT64_MAX;
+    }
+    return warmup->iterations + measured;
+}
+
+int64_t bench_message_index(int run, int64_t i, int64_t count)
+{
+    if (run < 0 || warmup == NULL) {
+        return i % count;
+    }
+    return (warmup->iterations + i) % count;
+}
+
+int64_t bench_peer_measured_start(int64_t count)
+{
+    int64_t warmed = warmup != NULL ? warmup->iterations : 0;
+
+    if (warmed < 0) {
+        return INT64_MAX;
+    }
+    return warmed + count * bench_opts.warmup_runs;
+}
+
+void bench_lock(void *p, size_t len)
+{
+    if (bench_opts.mlock && len > 0 && mlock(p, len)) {
+        perror("mlock");
+    }
+}
+
+void bench_prefault(void *p, size_t len)
+{
+    volatile char *c = p;
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    for (size_t off = 0; off < len; off += page) {
+        c[off] = c[off];
+    }
+    if (len > 0) {
+        c[len - 1] = c[len - 1];
+    }
+    bench_lock(p, len);
+}
@@ -0,0 +1,114 @@
+/*
+    Command line options shared by all benchmarks
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_BENCH_H
+#define IPC_BENCH_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum bench_pages {
+    PAGES_DEFAULT, /* malloc and regular shared memory */
+    PAGES_THP,     /* transparent huge pages through madvise */
+    PAGES_2M,      /* hugetlb pages */
+    PAGES_1G,
+};
+
+struct bench_options {
+    int runs;                 /* measured repetitions of the benchmark loop */
+    int warmup_runs;          /* repetitions run first and discarded */
+    int64_t warmup_iterations; /* iterations of the warmup phase */
+    int64_t warmup_ns;        /* or duration of the warmup phase */
+    int mlock;                /* lock message buffers and shared regions */
+    int perf;                 /* report performance counters */
+    enum bench_pages pages;   /* backing of buffers and shared regions */
+    const char *hugetlbfs;    /* mount point for hugetlb shared regions */
+};
+
+extern struct bench_options bench_opts;
+
+/* Take the common --name=value options out of argv, leaving the
+ * positional arguments in place. Returns -1 on a bad or unknown option. */
+int bench_parse_options(int *argc, char *argv[]);
+/* Called first by benchmarks that pass no data, so that bench_parse_options
+ * rejects --pages and --hugetlbfs instead of ignoring them */
+void bench_no_buffers(void);
+const char *bench_usage(void);
+
+/* Total number of benchmark loop repetitions, warmup included */
+int bench_total_runs(void);
+
+/* Run counter of the first pass over the benchmark loop, -1 when a warmup
+ * phase comes before the measured runs:
+ *
+ *     for (run = bench_first_run(); run < bench_total_runs(); run++) {
+ *         start = now_ns();
+ *         for (i = 0; bench_run_continues(run, i, count); i++) {
+ *             ...
+ *         }
+ *         delta = now_ns() - start;
+ *         if (bench_warmup_done(run, i, delta)) {
+ *             continue;
+ *         }
+ *         ...
+ *     }
+ */
+int bench_first_run(void);
+int bench_warmup_continues(int64_t i);
+static inline int bench_run_continues(int run, int64_t i, int64_t count)
+{
+    return run >= 0 ? i < count : bench_warmup_continues(i);
+}
+/* Reports the cold start cost, returns 1 if run was the warmup phase */
+int bench_warmup_done(int run, int64_t iterations, int64_t ns);
+
+/* Iterations the peer process serves, warmup included. Until the warmup
+ * phase of a duration based warmup ends this is larger than any count,
+ * so it has to be evaluated again on every iteration. */
+int64_t bench_peer_iterations(int64_t count);
+/* Index into a count sized table of the message sent in iteration i of
+ * run. The sequence continues from the warmup into the measured runs, so
+ * the peer, which cannot tell when the warmup ends, uses i % count. */
+int64_t bench_message_index(int run, int64_t i, int64_t count);
+/* First iteration of the peer that belongs to a measured run */
+int64_t bench_peer_measured_start(int64_t count);
+
+/* Fault in len bytes at p, and lock them with --mlock. The pages are
+ * written, so for regions shared with a running peer use bench_lock. */
+void bench_prefault(void *p, size_t len);
+void bench_lock(void *p, size_t len);
+
+/* Remove "--name=value" from argv and return value, "" for a bare
+ * "--name" flag and NULL if the option is not present */
+const char *bench_take_option(int *argc, char *argv[], const char *name);
+/* Same for an integer option of at least min, *out is left alone if the
+ * option is not present. Returns -1 after a diagnostic on a bad value. */
+int bench_take_int_option(int *argc, char *argv[], const char *name,
+                          int min, int *out);
+
+#endif
@@ -0,0 +1,514 @@
+/*
+    Measure the rate and latency of connection setup and teardown
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "memory.h"
+#include "perf.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
+#include "workload.h"
+
+#define MAX_THREADS 256
+
+static struct {
+    int unix_family;  /* unix stream sockets instead of TCP */
+    int clients;      /* connecting threads */
+    int acceptors;    /* accepting threads */
+    int size;         /* request and response */
+    int backlog;
+    int reuseport;    /* one SO_REUSEPORT listener per acceptor */
+    int fastopen;     /* request in the SYN */
+    int accept4;      /* accept4(SOCK_CLOEXEC), else accept and fcntl */
+} cfg = {
+    .clients = 1,
+    .acceptors = 1,
+    .size = 64,
+    .backlog = SOMAXCONN,
+};
+
+static struct sockaddr_storage addr;
+static socklen_t addr_len;
+static int listeners[MAX_THREADS];
+
+static int64_t count;
+static int current_run;
+static atomic_int_fast64_t next_connection; /* handed out to the clients */
+static atomic_int_fast64_t connections;     /* completed in this run */
+static atomic_int_fast64_t latency_sum;
+static atomic_int_fast64_t accepted;        /* by all acceptors */
+static atomic_int failed;
+static int64_t *latencies;                  /* of all measured runs */
+
+/* The client threads live across the runs, the main thread starts each
+ * run and waits for them to finish it */
+static pthread_mutex_t run_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t run_cond = PTHREAD_COND_INITIALIZER;
+static int started_run;
+static int clients_done;
+
+static int parse_options(int *argc, char *argv[])
+{
+    const char *family = bench_take_option(argc, argv, "family");
+
+    if (family != NULL && strcmp(family, "unix") == 0) {
+        cfg.unix_family = 1;
+    } else if (family != NULL && strcmp(family, "tcp") != 0) {
+        fprintf(stderr, "bad value for --family: '%s'\n", family);
+        return -1;
+    }
+    cfg.reuseport = bench_take_option(argc, argv, "reuseport") != NULL;
+    cfg.fastopen = bench_take_option(argc, argv, "fastopen") != NULL;
+    cfg.accept4 = bench_take_option(argc, argv, "accept4") != NULL;
+#ifndef __linux__
+    if (cfg.accept4) {
+        fprintf(stderr, "--accept4 needs Linux\n");
+        return -1;
+    }
+#endif
+    if (bench_take_int_option(argc, argv, "clients", 1, &cfg.clients) ||
+            bench_take_int_option(argc, argv, "acceptors", 1,
+                                  &cfg.acceptors) ||
+            bench_take_int_option(argc, argv, "size", 1, &cfg.size) ||
+            bench_take_int_option(argc, argv, "backlog", 1, &cfg.backlog)) {
+        return -1;
+    }
+    if (cfg.clients > MAX_THREADS || cfg.acceptors > MAX_THREADS) {
+        fprintf(stderr, "at most %d clients and acceptors\n", MAX_THREADS);
+        return -1;
+    }
+    if (cfg.unix_family && (cfg.reuseport || cfg.fastopen)) {
+        fprintf(stderr, "--reuseport and --fastopen need --family=tcp\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int listen_socket(int *out)
+{
+    int fd, yes = 1;
+
+    fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (fd == -1) {
+        perror("socket");
+        return -1;
+    }
+    if (!cfg.unix_family &&
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes))) {
+        perror("setsockopt SO_REUSEADDR");
+        return -1;
+    }
+#ifdef SO_REUSEPORT
+    if (cfg.reuseport &&
+            setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes))) {
+        perror("setsockopt SO_REUSEPORT");
+        return -1;
+    }
+#endif
+#ifdef TCP_FASTOPEN
+    if (cfg.fastopen && setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN,
+                                   &cfg.backlog, sizeof(cfg.backlog))) {
+        perror("setsockopt TCP_FASTOPEN");
+        return -1;
+    }
+#endif
+    if (bind(fd, (struct sockaddr *)&addr, addr_len) == -1) {
+        perror("bind");
+        return -1;
+    }
+    if (listen(fd, cfg.backlog) == -1) {
+        perror("listen");
+        return -1;
+    }
+    /* the first listener picks the port, the others share it */
+    if (getsockname(fd, (struct sockaddr *)&addr, &addr_len) == -1) {
+        perror("getsockname");
+        return -1;
+    }
+    *out = fd;
+    return 0;
+}
+
+static int setup_listeners(void)
+{
+    struct sockaddr_in *in = (struct sockaddr_in *)&addr;
+    struct sockaddr_un *un = (struct sockaddr_un *)&addr;
+
+    memset(&addr, 0, sizeof(addr));
+    if (cfg.unix_family) {
+        un->sun_family = AF_UNIX;
+        snprintf(un->sun_path, sizeof(un->sun_path),
+                 "/tmp/ipc-bench-connect-%ld", (long)getpid());
+        unlink(un->sun_path);
+        addr_len = sizeof(*un);
+    } else {
+        in->sin_family = AF_INET;
+        in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        in->sin_port = 0;
+        addr_len = sizeof(*in);
+    }
+
+    for (int a = 0; a < (cfg.reuseport ? cfg.acceptors : 1); a++) {
+        if (listen_socket(&listeners[a])) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* One short lived connection: connect, send the request, read the
+ * response and close */
+static int connect_once(char *buf)
+{
+    int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+
+    if (fd == -1) {
+        perror("socket");
+        return -1;
+    }
+#ifdef MSG_FASTOPEN
+    if (cfg.fastopen) {
+        /* connects, and sends the request with the SYN given a cookie */
+        if (sendto(fd, buf, cfg.size, MSG_FASTOPEN, (struct sockaddr *)&addr,
+                   addr_len) != cfg.size) {
+            perror("sendto MSG_FASTOPEN");
+            close(fd);
+            return -1;
+        }
+    } else
+#endif
+    {
+        if (connect(fd, (struct sockaddr *)&addr, addr_len) == -1) {
+            perror("connect");
+            close(fd);
+            return -1;
+        }
+        if (write(fd, buf, cfg.size) != cfg.size) {
+            perror("write");
+            close(fd);
+            return -1;
+        }
+    }
+    if (read_full(fd, buf, cfg.size)) {
+        perror("read");
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+/* Connects until the current run is complete */
+static void client_run(char *buf)
+{
+    int64_t i, t0, ns;
+
+    while (!atomic_load(&failed)) {
+        i = atomic_fetch_add(&next_connection, 1);
+        if (!bench_run_continues(current_run, i, count)) {
+            break;
+        }
+        t0 = now_ns();
+        if (connect_once(buf)) {
+            atomic_store(&failed, 1);
+            break;
+        }
+        ns = now_ns() - t0;
+        atomic_fetch_add(&connections, 1);
+        atomic_fetch_add(&latency_sum, ns);
+        if (current_run >= bench_opts.warmup_runs) {
+            latencies[(current_run - bench_opts.warmup_runs) * count + i] = ns;
+        }
+    }
+}
+
+static void *client_main(void *arg)
+{
+    realtime_enter_peer();
+    for (int run = bench_first_run(); run < bench_total_runs(); run++) {
+        pthread_mutex_lock(&run_lock);
+        while (started_run < run) {
+            pthread_cond_wait(&run_cond, &run_lock);
+        }
+        pthread_mutex_unlock(&run_lock);
+
+        client_run(arg);
+
+        pthread_mutex_lock(&run_lock);
+        clients_done++;
+        pthread_cond_broadcast(&run_cond);
+        pthread_mutex_unlock(&run_lock);
+    }
+    return NULL;
+}
+
+struct acceptor {
+    pthread_t thread;
+    int fd;
+    int slot;
+};
+
+/* Serves connections until the listener is shut down */
+static void *acceptor_main(void *arg)
+{
+    struct acceptor *a = arg;
+    char *buf = memory_alloc(cfg.size);
+    int fd;
+
+    if (buf == NULL) {
+        return NULL;
+    }
+    realtime_enter_peer();
+    perf_counters_open(a->slot);
+    bench_prefault(buf, cfg.size);
+    for (;;) {
+        perf_counters_peer_mark(atomic_load(&accepted), count);
+#ifdef __linux__
+        if (cfg.accept4) {
+            fd = accept4(a->fd, NULL, NULL, SOCK_CLOEXEC);
+        } else
+#endif
+        {
+            fd = accept(a->fd, NULL, NULL);
+            if (fd != -1 && fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) {
+                perror("fcntl");
+            }
+        }
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+        if (read_full(fd, buf, cfg.size) ||
+                write(fd, buf, cfg.size) != cfg.size) {
+            perror("serve");
+        }
+        close(fd);
+        atomic_fetch_add(&accepted, 1);
+    }
+    perf_counters_stop();
+    free(buf);
+    return NULL;
+}
+
+/* The server process, runs until the parent closes the control pipe */
+static int serve(int control)
+{
+    struct acceptor acceptors[MAX_THREADS];
+    char c;
+
+    for (int a = 0; a < cfg.acceptors; a++) {
+        acceptors[a].fd = listeners[cfg.reuseport ? a : 0];
+        acceptors[a].slot = a + 1;
+        if (pthread_create(&acceptors[a].thread, NULL, acceptor_main,
+                           &acceptors[a])) {
+            fprintf(stderr, "pthread_create failed\n");
+            return 1;
+        }
+    }
+    while (read(control, &c, 1) == -1 && errno == EINTR) {
+    }
+    /* wakes up the acceptors blocked in accept */
+    for (int l = 0; l < (cfg.reuseport ? cfg.acceptors : 1); l++) {
+        shutdown(listeners[l], SHUT_RDWR);
+    }
+    for (int a = 0; a < cfg.acceptors; a++) {
+        pthread_join(acceptors[a].thread, NULL);
+    }
+    return 0;
+}
+
+static void print_setup(void)
+{
+    FILE *f;
+    int v;
+
+    printf("connection count: %li\n", count);
+    printf("family: %s, clients: %d, acceptors: %d, request size: %d octets\n",
+           cfg.unix_family ? "unix" : "tcp", cfg.clients, cfg.acceptors,
+           cfg.size);
+    printf("accept: %s%s%s\n", cfg.accept4 ? "accept4" : "accept and fcntl",
+           cfg.reuseport ? ", SO_REUSEPORT listener per acceptor" : "",
+           cfg.fastopen ? ", TCP_FASTOPEN" : "");
+    if (cfg.fastopen) {
+        f = fopen("/proc/sys/net/ipv4/tcp_fastopen", "r");
+        if (f != NULL && fscanf(f, "%d", &v) == 1 && (v & 3) != 3) {
+            printf("warning: net.ipv4.tcp_fastopen is %d, 3 enables it for "
+                   "client and server\n", v);
+        }
+        if (f != NULL) {
+            fclose(f);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t clients[MAX_THREADS];
+    char *bufs[MAX_THREADS];
+    struct run_stats lat_stats, rate_stats;
+    int64_t delta, start;
+    int run, control[2];
+
+    if (parse_options(&argc, argv) || bench_parse_options(&argc, argv) ||
+            argc != 2) {
+        printf("usage: connect_rate [options] <connection-count>\n"
+               "  --family=F       tcp (default) or unix stream sockets\n"
+               "  --clients=N      connecting threads (default 1)\n"
+               "  --acceptors=N    accepting threads (default 1)\n"
+               "  --reuseport      one SO_REUSEPORT listener per acceptor\n"
+               "                   instead of a shared one\n"
+               "  --fastopen       send the request with TCP_FASTOPEN\n"
+               "  --accept4        accept4 with SOCK_CLOEXEC instead of\n"
+               "                   accept and fcntl\n"
+               "  --size=N         request and response size (default 64)\n"
+               "  --backlog=N      listen backlog (default SOMAXCONN)\n"
+               "%s",
+               bench_usage());
+        return 1;
+    }
+    count = atol(argv[1]);
+
+    latencies = malloc(count * bench_opts.runs * sizeof(*latencies));
+    if (latencies == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    for (int c = 0; c < cfg.clients; c++) {
+        bufs[c] = memory_alloc(cfg.size);
+        if (bufs[c] == NULL) {
+            return 1;
+        }
+        memset(bufs[c], 0, cfg.size);
+    }
+    if (run_stats_init(&lat_stats, "latency", "ns", bench_opts.runs) ||
+            run_stats_init(&rate_stats, "rate", "conn/s", bench_opts.runs)) {
+        return 1;
+    }
+
+    print_setup();
+    if (setup_listeners()) {
+        return 1;
+    }
+    if (pipe(control) == -1) {
+        perror("pipe");
+        return 1;
+    }
+
+    if (perf_counters_init(cfg.acceptors)) {
+        return 1;
+    }
+
+    if (!fork()) { /* child */
+        close(control[1]);
+        return serve(control[0]);
+    }
+
+    /* parent, the first client runs on the main thread */
+    close(control[0]);
+    for (int l = 0; l < (cfg.reuseport ? cfg.acceptors : 1); l++) {
+        close(listeners[l]);
+    }
+    bench_prefault(bufs[0], cfg.size);
+
+    /* created up front, so the runs do not time thread creation */
+    started_run = bench_first_run() - 1;
+    for (int c = 1; c < cfg.clients; c++) {
+        if (pthread_create(&clients[c], NULL, client_main, bufs[c])) {
+            fprintf(stderr, "pthread_create failed\n");
+            return 1;
+        }
+    }
+
+    perf_counters_open(0);
+    for (run = bench_first_run(); run < bench_total_runs(); run++) {
+        if (run == bench_opts.warmup_runs) {
+            perf_counters_start();
+        }
+        pthread_mutex_lock(&run_lock);
+        current_run = run;
+        atomic_store(&next_connection, 0);
+        atomic_store(&connections, 0);
+        atomic_store(&latency_sum, 0);
+        clients_done = 0;
+        started_run = run;
+        start = now_ns();
+        pthread_cond_broadcast(&run_cond);
+        pthread_mutex_unlock(&run_lock);
+
+        client_run(bufs[0]);
+        pthread_mutex_lock(&run_lock);
+        while (clients_done < cfg.clients - 1) {
+            pthread_cond_wait(&run_cond, &run_lock);
+        }
+        pthread_mutex_unlock(&run_lock);
+        if (atomic_load(&failed)) {
+            return 1;
+        }
+
+        delta = now_ns() - start;
+        if (bench_warmup_done(run, atomic_load(&connections), delta)) {
+            continue;
+        }
+        run_stats_add(&lat_stats, run, atomic_load(&latency_sum) / count);
+        run_stats_add(&rate_stats, run, count * 1000000000.0 / delta);
+    }
+    perf_counters_stop();
+    for (int c = 1; c < cfg.clients; c++) {
+        pthread_join(clients[c], NULL);
+    }
+    close(control[1]);
+
+    run_stats_report(&lat_stats);
+    run_stats_report(&rate_stats);
+    percentiles_report("latency", latencies, count * bench_opts.runs, "ns");
+    perf_counters_report("connection", count * bench_opts.runs);
+    if (cfg.unix_family) {
+        unlink(((struct sockaddr_un *)&addr)->sun_path);
+    }
+
+    return 0;
+}
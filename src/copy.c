@@ -0,0 +1,217 @@
+/*
+    Copy kernels for moving large frames into shared memory
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "copy.h"
+
+#include "bench.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define COPY_X86 1
+#include <immintrin.h>
+#endif
+
+static int always(void)
+{
+    return 1;
+}
+
+static void copy_memcpy(void *dst, const void *src, size_t len)
+{
+    memcpy(dst, src, len);
+}
+
+#ifdef COPY_X86
+static void copy_movsb(void *dst, const void *src, size_t len)
+{
+    __asm__ volatile("rep movsb"
+                     : "+D"(dst), "+S"(src), "+c"(len)
+                     :
+                     : "memory");
+}
+
+/* The non-temporal kernels copy the head up to the first aligned
+ * destination address and the tail with memcpy, stream the rest past the
+ * caches and fence, so the stores are visible before the frame is handed
+ * over. */
+static size_t head_of(const void *dst, size_t align, size_t len)
+{
+    size_t head = (align - ((uintptr_t)dst & (align - 1))) & (align - 1);
+
+    return head < len ? head : len;
+}
+
+__attribute__((target("avx2")))
+static void copy_nt_avx2(void *dst, const void *src, size_t len)
+{
+    char *d = dst;
+    const char *s = src;
+    size_t head = head_of(d, 32, len);
+
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    len -= head;
+    for (; len >= 128; d += 128, s += 128, len -= 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)s);
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(s + 64));
+        __m256i e = _mm256_loadu_si256((const __m256i *)(s + 96));
+
+        _mm256_stream_si256((__m256i *)d, a);
+        _mm256_stream_si256((__m256i *)(d + 32), b);
+        _mm256_stream_si256((__m256i *)(d + 64), c);
+        _mm256_stream_si256((__m256i *)(d + 96), e);
+    }
+    for (; len >= 32; d += 32, s += 32, len -= 32) {
+        _mm256_stream_si256((__m256i *)d,
+                            _mm256_loadu_si256((const __m256i *)s));
+    }
+    _mm_sfence();
+    memcpy(d, s, len);
+}
+
+__attribute__((target("avx512f")))
+static void copy_nt_avx512(void *dst, const void *src, size_t len)
+{
+    char *d = dst;
+    const char *s = src;
+    size_t head = head_of(d, 64, len);
+
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    len -= head;
+    for (; len >= 256; d += 256, s += 256, len -= 256) {
+        __m512i a = _mm512_loadu_si512(s);
+        __m512i b = _mm512_loadu_si512(s + 64);
+        __m512i c = _mm512_loadu_si512(s + 128);
+        __m512i e = _mm512_loadu_si512(s + 192);
+
+        _mm512_stream_si512((void *)d, a);
+        _mm512_stream_si512((void *)(d + 64), b);
+        _mm512_stream_si512((void *)(d + 128), c);
+        _mm512_stream_si512((void *)(d + 192), e);
+    }
+    for (; len >= 64; d += 64, s += 64, len -= 64) {
+        _mm512_stream_si512((void *)d, _mm512_loadu_si512(s));
+    }
+    _mm_sfence();
+    memcpy(d, s, len);
+}
+
+static int has_avx2(void)
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+static int has_avx512(void)
+{
+    return __builtin_cpu_supports("avx512f");
+}
+#endif
+
+#if defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define COPY_NEON 1
+/* stnp is the non-temporal store pair; the release of the semaphore that
+ * hands the frame over orders it like any other store */
+static void copy_nt_neon(void *dst, const void *src, size_t len)
+{
+    char *d = dst;
+    const char *s = src;
+
+    for (; len >= 64; d += 64, s += 64, len -= 64) {
+        __asm__ volatile("ldp q0, q1, [%1]\n\t"
+                         "ldp q2, q3, [%1, #32]\n\t"
+                         "stnp q0, q1, [%0]\n\t"
+                         "stnp q2, q3, [%0, #32]"
+                         :
+                         : "r"(d), "r"(s)
+                         : "v0", "v1", "v2", "v3", "memory");
+    }
+    memcpy(d, s, len);
+}
+#endif
+
+static const struct copy_kernel kernels[] = {
+    {"memcpy", copy_memcpy, always},
+#ifdef COPY_X86
+    {"movsb", copy_movsb, always},
+    {"nt-avx2", copy_nt_avx2, has_avx2},
+    {"nt-avx512", copy_nt_avx512, has_avx512},
+#endif
+#ifdef COPY_NEON
+    {"nt-neon", copy_nt_neon, always},
+#endif
+    {"inplace", NULL, always},
+};
+
+const struct copy_kernel *copy_kernel = &kernels[0];
+
+int copy_parse_options(int *argc, char *argv[])
+{
+    const char *name = bench_take_option(argc, argv, "copy");
+    size_t k;
+
+    copy_kernel = &kernels[0];
+    if (name == NULL) {
+        return 0;
+    }
+    for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (strcmp(name, kernels[k].name) == 0) {
+            break;
+        }
+    }
+    if (k == sizeof(kernels) / sizeof(kernels[0])) {
+        fprintf(stderr, "bad value for --copy: '%s'\n", name);
+        return -1;
+    }
+    if (!kernels[k].supported()) {
+        fprintf(stderr, "--copy=%s is not supported by this CPU\n", name);
+        return -1;
+    }
+    copy_kernel = &kernels[k];
+    return 0;
+}
+
+const char *copy_usage(void)
+{
+    return "copy options:\n"
+           "  --copy=KERNEL    memcpy, movsb for rep movsb, nt-avx2,\n"
+           "                   nt-avx512 or nt-neon for non-temporal\n"
+           "                   stores, or inplace to write the frame\n"
+           "                   straight into shared memory\n";
+}
+
+void copy_print(void)
+{
+    printf("copy: %s\n", copy_kernel->name);
+}
@@ -0,0 +1,52 @@
+/*
+    Copy kernels for moving large frames into shared memory
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_COPY_H
+#define IPC_BENCH_COPY_H
+
+#include <stddef.h>
+
+/* Writes len bytes at dst, which the receiver reads next */
+typedef void (*copy_fn)(void *dst, const void *src, size_t len);
+
+struct copy_kernel {
+    const char *name;
+    copy_fn copy;     /* NULL for in place, where there is nothing to copy */
+    int (*supported)(void);
+};
+
+/* Selected with --copy, libc memcpy by default */
+extern const struct copy_kernel *copy_kernel;
+
+/* Take --copy=KERNEL out of argv. Fails on kernels that the build or the
+ * CPU does not have. */
+int copy_parse_options(int *argc, char *argv[]);
+const char *copy_usage(void);
+void copy_print(void);
+
+#endif
@@ -34,23 +34,25 @@
 #include <unistd.h>
 #include <sys/time.h>
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
+#include "bench.h"
+#include "perf.h"
+#include "stats.h"
+#include "timing.h"
 
 int main(int argc, char *argv[])
 {
-    int i;
-    int64_t count, delta;
+    int i, run;
+    int64_t count, delta, start;
+    struct run_stats stats;
 #ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop, temp;
+    struct timespec temp;
 #else
-    struct timeval start, stop, temp;
+    struct timeval temp;
 #endif
 
-    if (argc != 2) {
-        printf("usage: gettimeofday <count>\n");
+    bench_no_buffers();
+    if (bench_parse_options(&argc, argv) || argc != 2) {
+        printf("usage: gettimeofday [options] <count>\n%s", bench_usage());
         return 1;
     }
 
@@ -58,53 +60,45 @@ int main(int argc, char *argv[])
 
     printf("measurements count: %li\n", count);
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-        perror("clock_gettime");
+    if (run_stats_init(&stats, "latency", "ns", bench_opts.runs)) {
         return 1;
     }
-#else
-    if (gettimeofday(&start, NULL) == -1) {
-        perror("gettimeofday");
+
+    if (perf_counters_init(0)) {
         return 1;
     }
-#endif
 
-    for (i = 0; i < count; i++) {
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &temp) == -1) {
-            perror("clock_gettime");
-            return 1;
+    perf_counters_open(0);
+    for (run = bench_first_run(); run < bench_total_runs(); run++) {
+        if (run == bench_opts.warmup_runs) {
+            perf_counters_start();
         }
-#else
-        if (gettimeofday(&temp, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
-        }
-#endif
-    }
+        start = now_ns();
 
+        for (i = 0; bench_run_continues(run, i, count); i++) {
 #ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-        perror("clock_gettime");
-        return 1;
-    }
-
-    delta = ((stop.tv_sec - start.tv_sec) * 1000000000 +
-             (stop.tv_nsec - start.tv_nsec));
-
+            if (clock_gettime(CLOCK_MONOTONIC, &temp) == -1) {
+                perror("clock_gettime");
+                return 1;
+            }
 #else
-    if (gettimeofday(&stop, NULL) == -1) {
-        perror("gettimeofday");
-        return 1;
-    }
-
-    delta =
-        (stop.tv_sec - start.tv_sec) * 1000000000 + (stop.tv_usec - start.tv_usec) * 1000;
-
+            if (gettimeofday(&temp, NULL) == -1) {
+                perror("gettimeofday");
+                return 1;
+            }
 #endif
+        }
+
+        delta = now_ns() - start;
+        if (bench_warmup_done(run, i, delta)) {
+            continue;
+        }
+        run_stats_add(&stats, run, delta / (count * 2));
+    }
+    perf_counters_stop();
 
-    printf("average latency: %li ns\n", delta / (count * 2));
+    run_stats_report(&stats);
+    perf_counters_report("measurement", count * bench_opts.runs);
 
     return 0;
 }
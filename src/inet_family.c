@@ -0,0 +1,115 @@
+/*
+    IPv4, IPv6 and IPv4-mapped IPv6 address selection
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "inet_family.h"
+
+#include "bench.h"
+
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+enum inet_family inet_family = INET_FAMILY_ANY;
+
+static const char *family_names[] = {
+    [INET_FAMILY_ANY] = "any",
+    [INET_FAMILY_V4] = "IPv4",
+    [INET_FAMILY_V6] = "IPv6",
+    [INET_FAMILY_MAPPED] = "IPv4-mapped IPv6",
+};
+
+int inet_family_parse_options(int *argc, char *argv[])
+{
+    const char *ip = bench_take_option(argc, argv, "ip");
+
+    if (ip == NULL) {
+        inet_family = INET_FAMILY_ANY;
+    } else if (strcmp(ip, "4") == 0) {
+        inet_family = INET_FAMILY_V4;
+    } else if (strcmp(ip, "6") == 0) {
+        inet_family = INET_FAMILY_V6;
+    } else if (strcmp(ip, "mapped") == 0) {
+        inet_family = INET_FAMILY_MAPPED;
+    } else {
+        fprintf(stderr, "bad value for --ip: '%s'\n", ip);
+        return -1;
+    }
+    return 0;
+}
+
+const char *inet_family_usage(void)
+{
+    return "address family options:\n"
+           "  --ip=F           4, 6 or mapped for IPv4 addresses on IPv6\n"
+           "                   sockets; loopback is 127.0.0.1, ::1 or\n"
+           "                   ::ffff:127.0.0.1\n";
+}
+
+void inet_family_print(void)
+{
+    if (inet_family != INET_FAMILY_ANY) {
+        printf("address family: %s\n", family_names[inet_family]);
+    }
+}
+
+const char *inet_family_loopback(void)
+{
+    return inet_family == INET_FAMILY_V6 ? "::1" : "127.0.0.1";
+}
+
+void inet_family_hints(struct addrinfo *hints)
+{
+    switch (inet_family) {
+    case INET_FAMILY_V4:
+        hints->ai_family = AF_INET;
+        break;
+    case INET_FAMILY_V6:
+        hints->ai_family = AF_INET6;
+        break;
+    case INET_FAMILY_MAPPED:
+        hints->ai_family = AF_INET6;
+        hints->ai_flags |= AI_V4MAPPED;
+        break;
+    default:
+        hints->ai_family = AF_UNSPEC;
+        break;
+    }
+}
+
+int inet_family_apply(int fd)
+{
+    int no = 0;
+
+    if (inet_family == INET_FAMILY_MAPPED &&
+            setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &no, sizeof(no)) == -1) {
+        perror("setsockopt IPV6_V6ONLY");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+/*
+    IPv4, IPv6 and IPv4-mapped IPv6 address selection
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_INET_FAMILY_H
+#define IPC_BENCH_INET_FAMILY_H
+
+#include <netdb.h>
+
+enum inet_family {
+    INET_FAMILY_ANY,    /* whatever getaddrinfo returns first */
+    INET_FAMILY_V4,     /* AF_INET */
+    INET_FAMILY_V6,     /* AF_INET6 */
+    INET_FAMILY_MAPPED, /* IPv4 through an AF_INET6 socket, ::ffff:a.b.c.d */
+};
+
+extern enum inet_family inet_family;
+
+/* Take --ip=4|6|mapped out of argv */
+int inet_family_parse_options(int *argc, char *argv[]);
+const char *inet_family_usage(void);
+void inet_family_print(void);
+
+/* The loopback address of the family, 127.0.0.1 unless IPv6 is chosen */
+const char *inet_family_loopback(void);
+/* Restrict getaddrinfo to the family, IPv4 results are mapped for
+ * INET_FAMILY_MAPPED */
+void inet_family_hints(struct addrinfo *hints);
+/* Accept IPv4 on an AF_INET6 socket for INET_FAMILY_MAPPED, whatever
+ * net.ipv6.bindv6only says; call before bind */
+int inet_family_apply(int fd);
+
+#endif
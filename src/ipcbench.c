@@ -0,0 +1,366 @@
+/*
+    Measure latency or throughput of any transport with one driver
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "memory.h"
+#include "perf.h"
+#include "realtime.h"
+#include "stats.h"
+#include "tcp_tuning.h"
+#include "timing.h"
+#include "transport.h"
+#include "workload.h"
+
+static const struct transport *transports[] = {
+    &transport_pipe,
+    &transport_unix,
+    &transport_tcp,
+    &transport_udp,
+    &transport_sysv_msgqueue,
+    &transport_sysv_semaphore,
+#ifndef __APPLE__
+    &transport_posix_msgqueue,
+    &transport_posix_sharedmem,
+#endif
+    NULL
+};
+
+enum mode {
+    MODE_LATENCY,
+    MODE_THROUGHPUT,
+};
+
+static void usage(void)
+{
+    printf("usage: ipcbench [options] --transport=<name> <message-size> <count>\n"
+           "  --transport=NAME one of the transports below\n"
+           "  --mode=MODE      latency (roundtrips, default) or throughput\n"
+           "                   (one way messages)\n"
+           "  --threads        run the peer as a thread instead of a process\n"
+           "transports:\n");
+    for (int t = 0; transports[t] != NULL; t++) {
+        printf("  %-16s %s\n", transports[t]->name, transports[t]->description);
+    }
+    printf("%s%s%s", workload_usage(), tcp_tuning_usage(), bench_usage());
+}
+
+static const struct transport *find_transport(const char *name)
+{
+    for (int t = 0; transports[t] != NULL; t++) {
+        if (strcmp(transports[t]->name, name) == 0) {
+            return transports[t];
+        }
+    }
+    return NULL;
+}
+
+struct peer {
+    const struct transport *t;
+    void *shared;
+    const size_t *sizes;
+    int64_t count;
+    size_t max_size;
+    enum mode mode;
+    int status;
+};
+
+/* The peer: echo every message back, or only receive them */
+static int serve(struct peer *p)
+{
+    const struct transport *t = p->t;
+    size_t len = t->headroom + (p->max_size > 0 ? p->max_size : 1);
+    char *buf = memory_alloc(len);
+    void *ep;
+    ssize_t n;
+
+    if (buf == NULL) {
+        return 1;
+    }
+    ep = t->open(p->shared, SIDE_CHILD);
+    if (ep == NULL) {
+        return 1;
+    }
+    bench_prefault(buf, len);
+    buf += t->headroom;
+    realtime_enter_peer();
+    perf_counters_open(1);
+
+    for (int64_t i = 0; i < bench_peer_iterations(p->count); i++) {
+        len = p->sizes[i % p->count];
+
+        perf_counters_peer_mark(i, p->count);
+        /* after a loss the sizes no longer line up, echo what came */
+        n = t->recv(ep, buf, t->lossy ? p->max_size : len);
+        if (n == TRANSPORT_LOST) {
+            break; /* short of the requests that were lost */
+        }
+        if (t->lossy && n >= 0) {
+            len = n;
+        }
+        if (n != (ssize_t)len) {
+            fprintf(stderr, "%s: message %li truncated\n", t->name, (long)i);
+            return 1;
+        }
+        if (p->mode == MODE_LATENCY && t->send(ep, buf, len)) {
+            return 1;
+        }
+    }
+    perf_counters_stop();
+    t->close(ep);
+    return 0;
+}
+
+static void *peer_thread(void *arg)
+{
+    struct peer *p = arg;
+
+    p->status = serve(p);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    const struct transport *t = NULL;
+    const char *name, *mode_name;
+    int threads;
+    pthread_t thread;
+    struct peer peer;
+    enum mode mode = MODE_LATENCY;
+    struct workload wl;
+    size_t *sizes, len;
+    struct size_histogram hist;
+    struct run_stats stats, thr_stats;
+    int64_t count, i, bytes, delta, start, t0 = 0, rtt;
+    int64_t rtt_sum, lost, lost_total = 0;
+    ssize_t n;
+    int run;
+    char *buf;
+    void *shared, *ep;
+
+    name = bench_take_option(&argc, argv, "transport");
+    mode_name = bench_take_option(&argc, argv, "mode");
+    threads = bench_take_option(&argc, argv, "threads") != NULL;
+    if (tcp_tuning_parse_options(&argc, argv) ||
+            bench_parse_options(&argc, argv) || argc != 3 || name == NULL) {
+        usage();
+        return 1;
+    }
+    t = find_transport(name);
+    if (t == NULL) {
+        fprintf(stderr, "unknown transport: %s\n", name);
+        return 1;
+    }
+    if (t != &transport_tcp && tcp_tuning_given()) {
+        fprintf(stderr, "tcp options need --transport=tcp\n");
+        return 1;
+    }
+    /* requests go out back to back, as from the tcp_thr sender */
+    if (tcp_opts.nodelay < 0) {
+        tcp_opts.nodelay = 1;
+    }
+    if (mode_name != NULL && strcmp(mode_name, "throughput") == 0) {
+        mode = MODE_THROUGHPUT;
+    } else if (mode_name != NULL && strcmp(mode_name, "latency") != 0) {
+        fprintf(stderr, "unknown mode: %s\n", mode_name);
+        return 1;
+    }
+    if (mode == MODE_THROUGHPUT && t->lossy) {
+        fprintf(stderr, "%s may drop messages, use --mode=latency\n", t->name);
+        return 1;
+    }
+
+    if (workload_parse(&wl, argv[1])) {
+        return 1;
+    }
+    if (t->max_size > 0 && wl.max_size > t->max_size) {
+        fprintf(stderr, "%s carries at most %zu octets per message\n", t->name,
+                t->max_size);
+        return 1;
+    }
+    count = atol(argv[2]);
+    sizes = workload_sizes(&wl, count);
+    if (sizes == NULL) {
+        return 1;
+    }
+    for (bytes = 0, i = 0; i < count; i++) {
+        bytes += sizes[i];
+    }
+    size_histogram_reset(&hist);
+
+    if (mode == MODE_LATENCY) {
+        if (run_stats_init(&stats, "latency", "ns", bench_opts.runs) ||
+                run_stats_init(&thr_stats, "throughput", "Mb/s",
+                               bench_opts.runs)) {
+            return 1;
+        }
+    } else {
+        if (run_stats_init(&stats, "throughput", "msg/s", bench_opts.runs) ||
+                run_stats_init(&thr_stats, "throughput", "Mb/s",
+                               bench_opts.runs)) {
+            return 1;
+        }
+    }
+
+    len = t->headroom + (wl.max_size > 0 ? wl.max_size : 1);
+    buf = memory_alloc(len);
+    if (buf == NULL) {
+        return 1;
+    }
+
+    printf("transport: %s\n", t->name);
+    workload_print(&wl);
+    if (!t->payload) {
+        printf("payload: none, only wakeups are passed\n");
+    }
+    printf("%s count: %li\n", mode == MODE_LATENCY ? "roundtrip" : "message",
+           (long)count);
+    printf("peer: %s\n", threads ? "thread" : "process");
+    if (t == &transport_tcp) {
+        tcp_tuning_print();
+    }
+    printf("pages: %s\n", memory_pages());
+
+    shared = t->setup(wl.max_size);
+    if (shared == NULL || perf_counters_init(1)) {
+        return 1;
+    }
+
+    peer.t = t;
+    peer.shared = shared;
+    peer.sizes = sizes;
+    peer.count = count;
+    peer.max_size = wl.max_size;
+    peer.mode = mode;
+    peer.status = 0;
+    if (threads) {
+        if ((errno = pthread_create(&thread, NULL, peer_thread, &peer))) {
+            perror("pthread_create");
+            return 1;
+        }
+    } else if (!fork()) { /* child */
+        return serve(&peer);
+    }
+
+    /* parent */
+    ep = t->open(shared, SIDE_PARENT);
+    if (ep == NULL) {
+        return 1;
+    }
+    bench_prefault(buf, len);
+    buf += t->headroom;
+
+    perf_counters_open(0);
+    for (run = bench_first_run(); run < bench_total_runs(); run++) {
+        if (run == bench_opts.warmup_runs) {
+            size_histogram_reset(&hist);
+            perf_counters_start();
+        }
+        rtt_sum = 0;
+        lost = 0;
+        start = now_ns();
+
+        for (i = 0; bench_run_continues(run, i, count); i++) {
+            len = sizes[bench_message_index(run, i, count)];
+            if (wl.kind != WORKLOAD_FIXED || t->lossy) {
+                t0 = now_ns();
+            }
+            if (t->send(ep, buf, len)) {
+                return 1;
+            }
+            if (mode != MODE_LATENCY) {
+                if (wl.kind != WORKLOAD_FIXED) {
+                    size_histogram_add(&hist, len, now_ns() - t0);
+                }
+                continue;
+            }
+            n = t->recv(ep, buf, len);
+            if (n == TRANSPORT_LOST) {
+                lost++;
+                continue;
+            }
+            if (n != (ssize_t)len) {
+                fprintf(stderr, "%s: reply %li truncated\n", t->name, (long)i);
+                return 1;
+            }
+            rtt = now_ns() - t0;
+            rtt_sum += rtt;
+            if (wl.kind != WORKLOAD_FIXED) {
+                size_histogram_add(&hist, len, rtt);
+            }
+        }
+
+        delta = now_ns() - start;
+        if (bench_warmup_done(run, i, delta)) {
+            continue;
+        }
+        lost_total += lost;
+        if (mode == MODE_LATENCY && lost > 0) {
+            /* the timeouts are no part of the latency */
+            run_stats_add(&stats, run, i > lost ? rtt_sum / ((i - lost) * 2)
+                                                : 0);
+            run_stats_add(&thr_stats, run, (bytes * 2 * 8 * 1000) / delta);
+        } else if (mode == MODE_LATENCY) {
+            run_stats_add(&stats, run, delta / (count * 2));
+            run_stats_add(&thr_stats, run, (bytes * 2 * 8 * 1000) / delta);
+        } else {
+            run_stats_add(&stats, run, (count * 1000000000) / delta);
+            run_stats_add(&thr_stats, run, (bytes * 8 * 1000) / delta);
+        }
+    }
+    perf_counters_stop();
+
+    run_stats_report(&stats);
+    if (lost_total > 0) {
+        printf("lost: %li of %li\n", (long)lost_total,
+               (long)(count * bench_opts.runs));
+    }
+    if (mode == MODE_THROUGHPUT || wl.kind != WORKLOAD_FIXED) {
+        run_stats_report(&thr_stats);
+    }
+    if (wl.kind != WORKLOAD_FIXED) {
+        printf("%s by size:\n", mode == MODE_LATENCY ? "latency"
+               : "per message send time");
+        size_histogram_print(&hist, mode == MODE_LATENCY ? 2 : 1);
+    }
+    if (threads) {
+        pthread_join(thread, NULL);
+    }
+    perf_counters_report(mode == MODE_LATENCY ? "roundtrip" : "message",
+                         count * bench_opts.runs);
+    t->close(ep);
+
+    return peer.status;
+}
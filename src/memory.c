@@ -0,0 +1,213 @@
+/*
+    Message buffers and shared regions backed by the selected page size
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/* memfd_create */
+#define _GNU_SOURCE
+
+#include "memory.h"
+
+#include "bench.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB 4U
+#endif
+
+#define THP_SIZE ((size_t)2 << 20)
+
+static const char *page_names[] = {
+    [PAGES_DEFAULT] = "default",
+    [PAGES_THP] = "thp",
+    [PAGES_2M] = "2m",
+    [PAGES_1G] = "1g",
+};
+
+const char *memory_pages(void)
+{
+    return page_names[bench_opts.pages];
+}
+
+static size_t page_size(void)
+{
+    switch (bench_opts.pages) {
+    case PAGES_2M:
+        return (size_t)2 << 20;
+    case PAGES_1G:
+        return (size_t)1 << 30;
+    case PAGES_THP:
+        return THP_SIZE;
+    default:
+        return sysconf(_SC_PAGESIZE);
+    }
+}
+
+/* log2 of the huge page size, as MAP_HUGETLB and MFD_HUGETLB encode it */
+static int page_shift(void)
+{
+    return bench_opts.pages == PAGES_1G ? 30 : 21;
+}
+
+static size_t round_up(size_t len)
+{
+    size_t page = page_size();
+
+    return (len + page - 1) / page * page;
+}
+
+static void hugetlb_hint(void)
+{
+    fprintf(stderr, "no %s huge pages available? see "
+            "/sys/kernel/mm/hugepages/hugepages-%skB/nr_hugepages\n",
+            memory_pages(), bench_opts.pages == PAGES_1G ? "1048576" : "2048");
+}
+
+void *memory_alloc(size_t len)
+{
+    void *p;
+
+    if (len == 0) {
+        len = 1;
+    }
+    switch (bench_opts.pages) {
+    case PAGES_DEFAULT:
+        p = malloc(len);
+        if (p == NULL) {
+            perror("malloc");
+        }
+        return p;
+    case PAGES_THP:
+        p = aligned_alloc(THP_SIZE, round_up(len));
+        if (p == NULL) {
+            perror("aligned_alloc");
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        if (madvise(p, round_up(len), MADV_HUGEPAGE)) {
+            perror("madvise(MADV_HUGEPAGE)");
+        }
+#endif
+        return p;
+    default:
+#ifdef MAP_HUGETLB
+        p = mmap(NULL, round_up(len), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                 (page_shift() << MAP_HUGE_SHIFT), -1, 0);
+        if (p == MAP_FAILED) {
+            perror("mmap(MAP_HUGETLB)");
+            hugetlb_hint();
+            return NULL;
+        }
+        return p;
+#else
+        fprintf(stderr, "--pages=%s is not supported here\n", memory_pages());
+        return NULL;
+#endif
+    }
+}
+
+static int open_hugetlb_file(void)
+{
+    char path[4096];
+    int fd;
+
+    if (bench_opts.hugetlbfs == NULL) {
+#ifdef __linux__
+        fd = memfd_create("ipc-bench", MFD_HUGETLB |
+                          (page_shift() << MAP_HUGE_SHIFT));
+        if (fd == -1) {
+            perror("memfd_create(MFD_HUGETLB)");
+        }
+        return fd;
+#else
+        fprintf(stderr, "--pages=%s needs --hugetlbfs here\n", memory_pages());
+        return -1;
+#endif
+    }
+
+    /* unlinked right away, the mapping keeps the pages */
+    snprintf(path, sizeof(path), "%s/ipc-bench-%ld", bench_opts.hugetlbfs,
+             (long)getpid());
+    fd = open(path, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) {
+        perror(path);
+        return -1;
+    }
+    unlink(path);
+    return fd;
+}
+
+void *memory_alloc_shared(size_t len)
+{
+    void *p;
+    int fd = -1;
+    int flags = MAP_SHARED;
+
+    len = round_up(len > 0 ? len : 1);
+    if (bench_opts.pages == PAGES_2M || bench_opts.pages == PAGES_1G) {
+        fd = open_hugetlb_file();
+        if (fd == -1) {
+            return NULL;
+        }
+        if (ftruncate(fd, len)) {
+            perror("ftruncate()");
+            hugetlb_hint();
+            return NULL;
+        }
+    } else {
+        flags |= MAP_ANONYMOUS;
+    }
+
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap()");
+        if (fd != -1) {
+            hugetlb_hint();
+        }
+        return NULL;
+    }
+    if (fd != -1) {
+        close(fd);
+    }
+#ifdef MADV_HUGEPAGE
+    /* shared memory needs shmem_enabled=advise for this to have effect */
+    if (bench_opts.pages == PAGES_THP && madvise(p, len, MADV_HUGEPAGE)) {
+        perror("madvise(MADV_HUGEPAGE)");
+    }
+#endif
+    return p;
+}
@@ -0,0 +1,47 @@
+/*
+    Message buffers and shared regions backed by the selected page size
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_MEMORY_H
+#define IPC_BENCH_MEMORY_H
+
+#include <stddef.h>
+
+/* A private buffer, for example the message buffer of one process. With
+ * --pages=thp it is aligned and advised for transparent huge pages, with
+ * --pages=2m or 1g it is taken from the hugetlb pool. Returns NULL after
+ * printing a diagnostic. */
+void *memory_alloc(size_t len);
+
+/* A region shared with peers forked after the call. Huge pages come from
+ * memfd_create(MFD_HUGETLB), or from a file in --hugetlbfs=DIR. */
+void *memory_alloc_shared(size_t len);
+
+/* Name of the page size in use, "default" without --pages */
+const char *memory_pages(void);
+
+#endif
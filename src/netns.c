@@ -0,0 +1,304 @@
+/*
+    Network namespace and veth pair setup
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#define _GNU_SOURCE
+
+#include "netns.h"
+
+#include "bench.h"
+#include "inet_family.h"
+#include "workload.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+enum netns_mode netns_mode = NETNS_OFF;
+
+static const char *mode_names[] = {
+    [NETNS_OFF] = "loopback",
+    [NETNS_VETH] = "veth pair to a child network namespace",
+    [NETNS_BRIDGE] = "veth pairs from two network namespaces to a bridge",
+};
+
+static long owner;          /* pid naming the links and addresses */
+static char ipv4[2][32];    /* parent and child address */
+static char ipv6[2][64];
+
+int netns_parse_options(int *argc, char *argv[])
+{
+    const char *mode = bench_take_option(argc, argv, "netns");
+    unsigned long net;
+
+    if (mode == NULL) {
+        netns_mode = NETNS_OFF;
+        return 0;
+    } else if (strcmp(mode, "veth") == 0) {
+        netns_mode = NETNS_VETH;
+    } else if (strcmp(mode, "bridge") == 0) {
+        netns_mode = NETNS_BRIDGE;
+    } else {
+        fprintf(stderr, "bad value for --netns: '%s'\n", mode);
+        return -1;
+    }
+#ifndef __linux__
+    fprintf(stderr, "--netns needs Linux\n");
+    return -1;
+#endif
+
+    /* a /30 out of 100.64.0.0/10 and a /64 per run, so concurrent runs
+     * do not collide */
+    owner = (long)getpid();
+    net = (100UL << 24 | 64UL << 16) + ((owner & 0xfffff) << 2);
+    for (int side = 0; side < 2; side++) {
+        unsigned long a = net + side + 1;
+
+        snprintf(ipv4[side], sizeof(ipv4[side]), "%lu.%lu.%lu.%lu",
+                 a >> 24, (a >> 16) & 0xff, (a >> 8) & 0xff, a & 0xff);
+        snprintf(ipv6[side], sizeof(ipv6[side]), "fd69:7063:%lx:%lx::%d",
+                 (owner >> 16) & 0xffff, owner & 0xffff, side + 1);
+    }
+    return 0;
+}
+
+const char *netns_usage(void)
+{
+    return "network namespace options (need CAP_NET_ADMIN and iproute2):\n"
+           "  --netns=veth     run the child in its own network namespace\n"
+           "                   behind a veth pair\n"
+           "  --netns=bridge   run both in their own namespace, connected\n"
+           "                   by veth pairs to a bridge\n";
+}
+
+void netns_print(void)
+{
+    if (netns_mode != NETNS_OFF) {
+        printf("network: %s, %s and %s\n", mode_names[netns_mode],
+               netns_address(0), netns_address(1));
+    }
+}
+
+const char *netns_address(int child)
+{
+    if (netns_mode == NETNS_OFF) {
+        return inet_family_loopback();
+    }
+    return inet_family == INET_FAMILY_V6 ? ipv6[child] : ipv4[child];
+}
+
+#ifdef __linux__
+static int up[2], down[2];  /* child is in its namespace, links are ready */
+static int root_ns = -1;
+
+/* Runs a shell command, in the given namespace unless ns is -1 */
+static int run(int ns, const char *cmd)
+{
+    pid_t pid;
+    int status;
+
+    pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        if (ns != -1 && setns(ns, CLONE_NEWNET) == -1) {
+            perror("setns");
+            _exit(127);
+        }
+        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        perror("execl");
+        _exit(127);
+    }
+    if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "network setup failed: %s\n", cmd);
+        return -1;
+    }
+    return 0;
+}
+
+/* Brings up lo and the given link with both addresses of one side */
+static int configure(int side, const char *link)
+{
+    char cmd[512];
+
+    snprintf(cmd, sizeof(cmd),
+             "ip link set lo up && ip addr add %s/30 dev %s && "
+             "ip -6 addr add %s/64 dev %s nodad && ip link set %s up",
+             ipv4[side], link, ipv6[side], link, link);
+    return run(-1, cmd);
+}
+
+int netns_init(void)
+{
+    if (netns_mode == NETNS_OFF) {
+        return 0;
+    }
+    root_ns = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+    if (root_ns == -1) {
+        perror("open /proc/self/ns/net");
+        return -1;
+    }
+    if (pipe(up) == -1 || pipe(down) == -1) {
+        perror("pipe");
+        return -1;
+    }
+    return 0;
+}
+
+int netns_enter_child(void)
+{
+    char link[16], go;
+    pid_t pid = getpid();
+
+    if (netns_mode == NETNS_OFF) {
+        return 0;
+    }
+    close(up[0]);
+    close(down[1]);
+    if (unshare(CLONE_NEWNET) == -1) {
+        perror("unshare CLONE_NEWNET");
+        return -1;
+    }
+    if (write_full(up[1], &pid, sizeof(pid))) {
+        perror("write");
+        return -1;
+    }
+    if (read_full(down[0], &go, 1)) {
+        return -1;
+    }
+    close(up[1]);
+    close(down[0]);
+
+    snprintf(link, sizeof(link), "ipcb%ld-c", owner);
+    return configure(1, link);
+}
+
+/* Namespaces go away with their processes, but not always before the
+ * next run, so the links in the root namespace are deleted at exit */
+static void remove_links(void)
+{
+    char cmd[128];
+
+    if (getpid() != owner) {
+        return;
+    }
+    if (netns_mode == NETNS_VETH) {
+        snprintf(cmd, sizeof(cmd), "ip link del ipcb%ld-p 2> /dev/null",
+                 owner);
+    } else {
+        snprintf(cmd, sizeof(cmd),
+                 "ip link del ipcb%ld-pr 2> /dev/null; "
+                 "ip link del ipcb%ld-cr 2> /dev/null; "
+                 "ip link del ipcb%ld-br", owner, owner, owner);
+    }
+    run(root_ns, cmd);
+}
+
+int netns_setup(void)
+{
+    char cmd[1024], prefix[12], link[16];
+    pid_t child;
+
+    if (netns_mode == NETNS_OFF) {
+        return 0;
+    }
+    close(up[1]);
+    close(down[0]);
+    if (read_full(up[0], &child, sizeof(child))) {
+        fprintf(stderr, "child exited before entering its namespace\n");
+        return -1;
+    }
+
+    atexit(remove_links);
+    snprintf(prefix, sizeof(prefix), "ipcb%ld", owner);
+    snprintf(link, sizeof(link), "%s-p", prefix);
+    if (netns_mode == NETNS_VETH) {
+        /* the parent end stays behind and is configured with the rest */
+        snprintf(cmd, sizeof(cmd),
+                 "ip link add %s type veth peer name %s-c && "
+                 "ip link set %s-c netns %ld && ip addr add %s/30 dev %s && "
+                 "ip -6 addr add %s/64 dev %s nodad && ip link set %s up",
+                 link, prefix, prefix, (long)child, ipv4[0], link, ipv6[0],
+                 link, link);
+        if (run(-1, cmd)) {
+            return -1;
+        }
+    } else {
+        if (unshare(CLONE_NEWNET) == -1) {
+            perror("unshare CLONE_NEWNET");
+            return -1;
+        }
+        snprintf(cmd, sizeof(cmd),
+                 "ip link add %s-br type bridge && ip link set %s-br up && "
+                 "ip link add %s-p type veth peer name %s-pr && "
+                 "ip link add %s-c type veth peer name %s-cr && "
+                 "ip link set %s-p netns %ld && ip link set %s-c netns %ld && "
+                 "ip link set %s-pr master %s-br up && "
+                 "ip link set %s-cr master %s-br up",
+                 prefix, prefix, prefix, prefix, prefix, prefix, prefix, owner,
+                 prefix, (long)child, prefix, prefix, prefix, prefix);
+        /* the root namespace ends and the bridge are set up from there */
+        if (run(root_ns, cmd) || configure(0, link)) {
+            return -1;
+        }
+    }
+
+    if (write(down[1], "", 1) != 1) {
+        perror("write");
+        return -1;
+    }
+    close(up[0]);
+    close(down[1]);
+    return 0;
+}
+#else
+int netns_init(void)
+{
+    return 0;
+}
+
+int netns_enter_child(void)
+{
+    return 0;
+}
+
+int netns_setup(void)
+{
+    return 0;
+}
+#endif
@@ -0,0 +1,58 @@
+/*
+    Network namespace and veth pair setup
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_NETNS_H
+#define IPC_BENCH_NETNS_H
+
+enum netns_mode {
+    NETNS_OFF,    /* both processes on loopback */
+    NETNS_VETH,   /* the child in its own namespace, a veth pair to it */
+    NETNS_BRIDGE, /* both in their own namespace, veth pairs to a bridge */
+};
+
+extern enum netns_mode netns_mode;
+
+/* Take --netns=veth|bridge out of argv */
+int netns_parse_options(int *argc, char *argv[]);
+const char *netns_usage(void);
+void netns_print(void);
+
+/* The address of the parent (0) or child (1) side in the family chosen
+ * with --ip, the loopback address without --netns */
+const char *netns_address(int child);
+
+/* Before fork */
+int netns_init(void);
+/* First thing in the child: moves into a new namespace and configures
+ * the interface once the parent has set up the link */
+int netns_enter_child(void);
+/* In the parent after fork: creates the veth pairs, and the bridge,
+ * which are removed again at exit */
+int netns_setup(void);
+
+#endif
@@ -0,0 +1,334 @@
+/*
+    Background load running alongside a benchmark
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#define _GNU_SOURCE
+
+#include "noise.h"
+
+#include "bench.h"
+
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#define MAX_SPECS 16
+#define MAX_WORKERS 256
+
+/* Copied back and forth by a memory worker, twice over */
+#define STREAM_BYTES (64 << 20)
+/* Bounds of the region a cache worker touches at random, twice the
+ * last level cache if its size is known */
+#define THRASH_MIN_BYTES (8 << 20)
+#define THRASH_MAX_BYTES (256 << 20)
+#define CACHE_LINE 64
+
+enum noise_kind {
+    NOISE_CPU,     /* arithmetic in registers */
+    NOISE_MEMORY,  /* memcpy streaming through memory bandwidth */
+    NOISE_CACHE,   /* random cache line writes evicting the caches */
+    NOISE_SYSCALL, /* getppid in a loop, kernel entry and exit */
+};
+
+static const char *kind_names[] = {
+    [NOISE_CPU] = "cpu",
+    [NOISE_MEMORY] = "memory",
+    [NOISE_CACHE] = "cache",
+    [NOISE_SYSCALL] = "syscall",
+};
+
+struct noise_spec {
+    enum noise_kind kind;
+    int workers;
+    int first_cpu, last_cpu; /* -1 when not pinned */
+};
+
+static struct noise_spec specs[MAX_SPECS];
+static int nspecs;
+static pid_t workers[MAX_WORKERS];
+static int nworkers;
+static pid_t owner;
+
+static void cpu_loop(void)
+{
+    volatile uint64_t sink;
+    uint64_t x = 1;
+
+    for (;;) {
+        for (int i = 0; i < 1000000; i++) {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        }
+        sink = x;
+    }
+    (void)sink;
+}
+
+static void memory_loop(void)
+{
+    char *a = malloc(STREAM_BYTES), *b = malloc(STREAM_BYTES);
+
+    if (a == NULL || b == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    memset(a, 1, STREAM_BYTES);
+    memset(b, 2, STREAM_BYTES);
+    for (;;) {
+        memcpy(b, a, STREAM_BYTES);
+        memcpy(a, b, STREAM_BYTES);
+    }
+}
+
+static void cache_loop(void)
+{
+    size_t len = THRASH_MIN_BYTES, lines;
+    uint64_t x = 0x2545f4914f6cdd1dULL;
+    volatile char *p;
+
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+
+    if (llc > 0 && (size_t)llc * 2 > len) {
+        len = (size_t)llc * 2;
+    }
+#endif
+    if (len > THRASH_MAX_BYTES) {
+        len = THRASH_MAX_BYTES;
+    }
+    p = malloc(len);
+    if (p == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    memset((char *)p, 0, len);
+    lines = len / CACHE_LINE;
+    for (;;) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        p[(x % lines) * CACHE_LINE]++;
+    }
+}
+
+static void syscall_loop(void)
+{
+    for (;;) {
+        getppid();
+    }
+}
+
+static int start_worker(enum noise_kind kind, int cpu)
+{
+    pid_t pid;
+
+    if (nworkers == MAX_WORKERS) {
+        fprintf(stderr, "--noise: at most %d workers\n", MAX_WORKERS);
+        return -1;
+    }
+    pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    }
+    if (pid > 0) {
+        workers[nworkers++] = pid;
+        return 0;
+    }
+
+#ifdef __linux__
+    /* do not outlive a benchmark that exits without noise_stop */
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != owner) {
+        exit(0);
+    }
+    if (cpu >= 0) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set)) {
+            perror("sched_setaffinity");
+            exit(1);
+        }
+    }
+#else
+    (void)cpu;
+#endif
+    switch (kind) {
+    case NOISE_CPU:
+        cpu_loop();
+        break;
+    case NOISE_MEMORY:
+        memory_loop();
+        break;
+    case NOISE_CACHE:
+        cache_loop();
+        break;
+    case NOISE_SYSCALL:
+        syscall_loop();
+        break;
+    }
+    exit(0);
+}
+
+/* KIND[:N][@CPU[-CPU]], the N workers are spread over the CPUs */
+static int parse_spec(const char *spec, struct noise_spec *ns)
+{
+    char name[16];
+    size_t len = strcspn(spec, ":@");
+    const char *p = spec + len;
+    char *end;
+    int kind;
+
+    if (len == 0 || len >= sizeof(name)) {
+        goto bad;
+    }
+    memcpy(name, spec, len);
+    name[len] = '\0';
+    for (kind = 0; kind <= NOISE_SYSCALL; kind++) {
+        if (strcmp(name, kind_names[kind]) == 0) {
+            break;
+        }
+    }
+    if (kind > NOISE_SYSCALL) {
+        goto bad;
+    }
+    ns->kind = kind;
+    ns->workers = 1;
+    ns->first_cpu = ns->last_cpu = -1;
+
+    if (*p == ':') {
+        ns->workers = strtol(p + 1, &end, 10);
+        if (end == p + 1 || ns->workers < 1) {
+            goto bad;
+        }
+        p = end;
+    }
+    if (*p == '@') {
+        ns->first_cpu = ns->last_cpu = strtol(p + 1, &end, 10);
+        if (end == p + 1 || ns->first_cpu < 0) {
+            goto bad;
+        }
+        p = end;
+        if (*p == '-') {
+            ns->last_cpu = strtol(p + 1, &end, 10);
+            if (end == p + 1 || ns->last_cpu < ns->first_cpu) {
+                goto bad;
+            }
+            p = end;
+        }
+#ifndef __linux__
+        fprintf(stderr, "--noise: pinning to CPUs needs Linux\n");
+        return -1;
+#endif
+    }
+    if (*p != '\0') {
+        goto bad;
+    }
+    return 0;
+
+bad:
+    fprintf(stderr, "bad value for --noise: '%s'\n", spec);
+    return -1;
+}
+
+int noise_parse_options(int *argc, char *argv[])
+{
+    const char *spec;
+
+    while ((spec = bench_take_option(argc, argv, "noise")) != NULL) {
+        if (nspecs == MAX_SPECS) {
+            fprintf(stderr, "--noise: at most %d specs\n", MAX_SPECS);
+            return -1;
+        }
+        if (parse_spec(spec, &specs[nspecs++])) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int noise_start(void)
+{
+    owner = getpid();
+    for (int s = 0; s < nspecs; s++) {
+        struct noise_spec *ns = &specs[s];
+
+        printf("noise: %d %s worker%s", ns->workers, kind_names[ns->kind],
+               ns->workers > 1 ? "s" : "");
+        if (ns->first_cpu >= 0) {
+            printf(" on cpu %d", ns->first_cpu);
+            if (ns->last_cpu > ns->first_cpu) {
+                printf("-%d", ns->last_cpu);
+            }
+        }
+        printf("\n");
+    }
+    /* the workers must not inherit unwritten output */
+    fflush(stdout);
+
+    for (int s = 0; s < nspecs; s++) {
+        struct noise_spec *ns = &specs[s];
+        int ncpus = ns->last_cpu - ns->first_cpu + 1;
+
+        for (int i = 0; i < ns->workers; i++) {
+            if (start_worker(ns->kind, ns->first_cpu < 0 ? -1
+                                       : ns->first_cpu + i % ncpus)) {
+                noise_stop();
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int noise_enabled(void)
+{
+    return nspecs > 0;
+}
+
+void noise_stop(void)
+{
+    if (getpid() != owner) {
+        return;
+    }
+    for (int i = 0; i < nworkers; i++) {
+        kill(workers[i], SIGKILL);
+        waitpid(workers[i], NULL, 0);
+    }
+    nworkers = 0;
+}
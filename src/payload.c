@@ -0,0 +1,216 @@
+/*
+    Sequence numbered payloads checked with CRC32C by the receiver
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "payload.h"
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* Diagnostics printed before the receiver only counts failures */
+#define MAX_REPORTED 5
+
+struct payload_counts {
+    int64_t checked;
+    int64_t failed;
+};
+
+int payload_verify;
+static struct payload_counts *counts;
+
+static uint32_t crc_table[256];
+static uint32_t (*crc_update)(uint32_t crc, const unsigned char *p,
+                              size_t len);
+
+static uint32_t crc_update_table(uint32_t crc, const unsigned char *p,
+                                 size_t len)
+{
+    while (len--) {
+        crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+__attribute__((target("sse4.2")))
+static uint32_t crc_update_sse42(uint32_t crc, const unsigned char *p,
+                                 size_t len)
+{
+    uint64_t c = crc, v;
+
+    for (; len >= sizeof(v); p += sizeof(v), len -= sizeof(v)) {
+        memcpy(&v, p, sizeof(v));
+        c = __builtin_ia32_crc32di(c, v);
+    }
+    while (len--) {
+        c = __builtin_ia32_crc32qi((uint32_t)c, *p++);
+    }
+    return (uint32_t)c;
+}
+#endif
+
+static const char *crc_setup(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+    crc_update = crc_update_table;
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc_update = crc_update_sse42;
+        return "sse4.2";
+    }
+#endif
+    return "table";
+}
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+{
+    if (crc_update == NULL) {
+        crc_setup();
+    }
+    return ~crc_update(~crc, buf, len);
+}
+
+int payload_parse_options(int *argc, char *argv[])
+{
+    payload_verify = bench_take_option(argc, argv, "verify") != NULL;
+    return 0;
+}
+
+const char *payload_usage(void)
+{
+    return "payload options:\n"
+           "  --verify         send sequence numbered patterns and have the\n"
+           "                   receiver check them with CRC32C\n";
+}
+
+void payload_print(void)
+{
+    if (payload_verify) {
+        printf("payload: sequence numbered pattern, CRC32C (%s) checked "
+               "by the receiver\n", crc_setup());
+    }
+}
+
+int payload_init(size_t min_size)
+{
+    if (!payload_verify) {
+        return 0;
+    }
+    if (min_size < PAYLOAD_HEADER) {
+        fprintf(stderr, "--verify needs messages of at least %d octets\n",
+                PAYLOAD_HEADER);
+        return -1;
+    }
+    if (crc_update == NULL) {
+        crc_setup();
+    }
+    counts = mmap(NULL, sizeof(*counts), PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (counts == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    memset(counts, 0, sizeof(*counts));
+    return 0;
+}
+
+/* CRC of the pattern, then of sequence number and length */
+static uint32_t payload_crc(const unsigned char *p, size_t len, uint64_t seq)
+{
+    uint64_t n = len;
+    uint32_t crc;
+
+    crc = crc32c(0, p + PAYLOAD_HEADER, len - PAYLOAD_HEADER);
+    crc = crc32c(crc, &seq, sizeof(seq));
+    return crc32c(crc, &n, sizeof(n));
+}
+
+void payload_fill(void *buf, size_t len, int64_t seq)
+{
+    unsigned char *p = buf;
+    uint64_t word = (uint64_t)seq * 0x9e3779b97f4a7c15ULL, s = seq;
+    uint32_t crc, n = len;
+    size_t off;
+
+    /* a different pattern in every message, so stale data shows */
+    for (off = PAYLOAD_HEADER; off + sizeof(word) <= len;
+            off += sizeof(word)) {
+        word ^= word << 13;
+        word ^= word >> 7;
+        memcpy(p + off, &word, sizeof(word));
+    }
+    memcpy(p + off, &word, len - off);
+
+    crc = payload_crc(p, len, s);
+    memcpy(p, &s, sizeof(s));
+    memcpy(p + 8, &crc, sizeof(crc));
+    memcpy(p + 12, &n, sizeof(n));
+}
+
+void payload_check(const void *buf, size_t len, int64_t seq)
+{
+    const unsigned char *p = buf;
+    uint64_t s;
+    uint32_t crc, n;
+
+    memcpy(&s, p, sizeof(s));
+    memcpy(&crc, p + 8, sizeof(crc));
+    memcpy(&n, p + 12, sizeof(n));
+
+    counts->checked++;
+    if (len >= PAYLOAD_HEADER && s == (uint64_t)seq && n == len &&
+            crc == payload_crc(p, len, s)) {
+        return;
+    }
+    if (counts->failed++ < MAX_REPORTED) {
+        fprintf(stderr, "payload of message %lli: got sequence %llu, "
+                        "length %u of %zu, %s checksum\n",
+                (long long)seq, (unsigned long long)s, n, len,
+                len >= PAYLOAD_HEADER && crc == payload_crc(p, len, s)
+                    ? "matching" : "bad");
+    }
+}
+
+int payload_report(void)
+{
+    if (!payload_verify) {
+        return 0;
+    }
+    printf("payload: %lli messages checked, %lli failed\n",
+           (long long)counts->checked, (long long)counts->failed);
+    return counts->failed ? -1 : 0;
+}
@@ -0,0 +1,63 @@
+/*
+    Sequence numbered payloads checked with CRC32C by the receiver
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_PAYLOAD_H
+#define IPC_BENCH_PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Sequence number, CRC32C and length in front of the pattern */
+#define PAYLOAD_HEADER 16
+
+/* Fill and check payloads, off without --verify */
+extern int payload_verify;
+
+/* Take --verify out of argv */
+int payload_parse_options(int *argc, char *argv[]);
+const char *payload_usage(void);
+void payload_print(void);
+
+/* Before fork: min_size is the smallest message, which has to hold the
+ * header. Sets up the counts shared with the receiver. */
+int payload_init(size_t min_size);
+
+/* Message number seq, counted from 0 over all runs warmup included: the
+ * header followed by a pattern derived from seq */
+void payload_fill(void *buf, size_t len, int64_t seq);
+/* Reads every byte and counts the message as failed if its checksum,
+ * length or sequence number is wrong, i.e. torn, corrupt or reordered */
+void payload_check(const void *buf, size_t len, int64_t seq);
+/* After the receiver has exited: prints the counts, -1 on failures */
+int payload_report(void);
+
+/* CRC32C (Castagnoli) of len bytes, continuing from crc (0 to start),
+ * with the SSE 4.2 instruction where the CPU has it */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+#endif
@@ -0,0 +1,370 @@
+/*
+    Performance counters and CPU accounting around the measured loop
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/* RUSAGE_THREAD */
+#define _GNU_SOURCE
+
+#include "perf.h"
+
+#include "bench.h"
+#include "noise.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+enum counter_status {
+    COUNTER_UNAVAILABLE,
+    COUNTER_OK,
+    COUNTER_USER_ONLY, /* kernel time excluded by perf_event_paranoid */
+};
+
+struct counter_def {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+};
+
+#ifdef __linux__
+#define CACHE_CONFIG(cache, op, result) \
+    ((cache) | ((op) << 8) | ((result) << 16))
+
+static const struct counter_def counters[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {
+        "LLC misses", PERF_TYPE_HW_CACHE,
+        CACHE_CONFIG(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ,
+                     PERF_COUNT_HW_CACHE_RESULT_MISS)
+    },
+    {
+        "dTLB load misses", PERF_TYPE_HW_CACHE,
+        CACHE_CONFIG(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                     PERF_COUNT_HW_CACHE_RESULT_MISS)
+    },
+    {
+        "dTLB store misses", PERF_TYPE_HW_CACHE,
+        CACHE_CONFIG(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_WRITE,
+                     PERF_COUNT_HW_CACHE_RESULT_MISS)
+    },
+    {"branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"context switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {"page faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+#define NCOUNTERS (sizeof(counters) / sizeof(counters[0]))
+#else
+#define NCOUNTERS 1
+#endif
+
+/* Where the time of a process went, from getrusage and schedstat */
+enum cpu_field {
+    CPU_USER,
+    CPU_SYSTEM,
+    CPU_RUNQUEUE,
+    CPU_VOLUNTARY,
+    CPU_INVOLUNTARY,
+    NCPU
+};
+
+static const char *cpu_names[NCPU] = {
+    "user time (ns)",
+    "system time (ns)",
+    "run queue wait (ns)",
+    "voluntary switches",
+    "involuntary switches",
+};
+
+/* Results of one process, in memory shared with the parent */
+struct counter_slot {
+    int status[NCOUNTERS];
+    double value[NCOUNTERS];
+    int cpu_status[NCPU];
+    double cpu_value[NCPU];
+};
+
+static struct counter_slot *slots;
+static int nslots;
+/* A peer may be a thread of the parent, so every thread keeps its own */
+static _Thread_local int my_slot = -1;
+static _Thread_local int fds[NCOUNTERS];
+static _Thread_local int running;
+static _Thread_local double cpu_begin[NCPU];
+
+int perf_counters_init(int npeers)
+{
+#ifndef __linux__
+    if (bench_opts.perf) {
+        fprintf(stderr, "--perf: performance counters need Linux, ignored\n");
+        bench_opts.perf = 0;
+    }
+#endif
+    nslots = npeers + 1;
+    slots = mmap(NULL, sizeof(*slots) * nslots, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (slots == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    memset(slots, 0, sizeof(*slots) * nslots);
+    return 0;
+}
+
+#ifdef __linux__
+static int open_counter(const struct counter_def *def, int exclude_kernel)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = def->type;
+    attr.config = def->config;
+    attr.disabled = 1;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+/* Run queue wait needs CONFIG_SCHEDSTATS, the rest is always there. The
+ * calling thread is sampled where possible, which for the single threaded
+ * processes is the same as the whole process. */
+static void cpu_sample(double *v, int *status)
+{
+    struct rusage ru;
+    unsigned long long run_ns, wait_ns;
+    FILE *f;
+
+    for (int c = 0; c < NCPU; c++) {
+        status[c] = COUNTER_UNAVAILABLE;
+    }
+#ifdef RUSAGE_THREAD
+    if (getrusage(RUSAGE_THREAD, &ru) == 0) {
+#else
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+#endif
+        v[CPU_USER] = ru.ru_utime.tv_sec * 1e9 + ru.ru_utime.tv_usec * 1e3;
+        v[CPU_SYSTEM] = ru.ru_stime.tv_sec * 1e9 + ru.ru_stime.tv_usec * 1e3;
+        v[CPU_VOLUNTARY] = ru.ru_nvcsw;
+        v[CPU_INVOLUNTARY] = ru.ru_nivcsw;
+        status[CPU_USER] = status[CPU_SYSTEM] = COUNTER_OK;
+        status[CPU_VOLUNTARY] = status[CPU_INVOLUNTARY] = COUNTER_OK;
+    }
+    f = fopen("/proc/thread-self/schedstat", "r");
+    if (f == NULL) {
+        f = fopen("/proc/self/schedstat", "r");
+    }
+    if (f != NULL) {
+        if (fscanf(f, "%llu %llu", &run_ns, &wait_ns) == 2) {
+            v[CPU_RUNQUEUE] = wait_ns;
+            status[CPU_RUNQUEUE] = COUNTER_OK;
+        }
+        fclose(f);
+    }
+}
+
+void perf_counters_open(int slot)
+{
+    if (slot >= nslots) {
+        return;
+    }
+    my_slot = slot;
+    if (!bench_opts.perf) {
+        return;
+    }
+#ifdef __linux__
+    for (size_t c = 0; c < NCOUNTERS; c++) {
+        int status = COUNTER_OK;
+
+        fds[c] = open_counter(&counters[c], 0);
+        if (fds[c] == -1 && (errno == EACCES || errno == EPERM)) {
+            fds[c] = open_counter(&counters[c], 1);
+            status = COUNTER_USER_ONLY;
+        }
+        slots[slot].status[c] = fds[c] == -1 ? COUNTER_UNAVAILABLE : status;
+    }
+#endif
+}
+
+void perf_counters_start(void)
+{
+    if (my_slot < 0 || running) {
+        return;
+    }
+    cpu_sample(cpu_begin, slots[my_slot].cpu_status);
+#ifdef __linux__
+    for (size_t c = 0; bench_opts.perf && c < NCOUNTERS; c++) {
+        if (fds[c] != -1) {
+            ioctl(fds[c], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+    running = 1;
+}
+
+void perf_counters_stop(void)
+{
+    struct counter_slot *slot;
+    double cpu_end[NCPU];
+    int cpu_status[NCPU];
+
+    if (my_slot < 0 || !running) {
+        return;
+    }
+    slot = &slots[my_slot];
+#ifdef __linux__
+    for (size_t c = 0; bench_opts.perf && c < NCOUNTERS; c++) {
+        uint64_t v[3]; /* value, time enabled, time running */
+
+        if (fds[c] == -1) {
+            continue;
+        }
+        ioctl(fds[c], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fds[c], v, sizeof(v)) != sizeof(v) || v[2] == 0) {
+            slot->status[c] = COUNTER_UNAVAILABLE;
+        } else {
+            /* scale up if the counter was multiplexed with others */
+            slot->value[c] = (double)v[0] * v[1] / v[2];
+        }
+        close(fds[c]);
+        fds[c] = -1;
+    }
+#endif
+    cpu_sample(cpu_end, cpu_status);
+    for (int c = 0; c < NCPU; c++) {
+        if (cpu_status[c] == COUNTER_UNAVAILABLE) {
+            slot->cpu_status[c] = COUNTER_UNAVAILABLE;
+        }
+        slot->cpu_value[c] = cpu_end[c] - cpu_begin[c];
+    }
+    running = 0;
+}
+
+void perf_counters_peer_mark(int64_t done, int64_t count)
+{
+    if (my_slot > 0 && !running && done >= bench_peer_measured_start(count)) {
+        perf_counters_start();
+    }
+}
+
+/* A value is shown for the peers if all of them could count it */
+static void merge_status(int *sum, int status, int first)
+{
+    if (first || status == COUNTER_UNAVAILABLE) {
+        *sum = status;
+    }
+}
+
+static void print_value(int status, double value, int n, double div)
+{
+    if (n == 0 || status == COUNTER_UNAVAILABLE) {
+        printf(" %14s", "n/a");
+    } else {
+        printf(" %14.2f", value / (n * div));
+    }
+}
+
+static void print_header(const char *title, const char *per, int npeers)
+{
+    printf("%s per %s:\n", title, per);
+    printf("  %-28s %14s", "", "parent");
+    if (npeers > 0) {
+        printf(" %14s", npeers > 1 ? "child average" : "child");
+    }
+    printf("\n");
+}
+
+void perf_counters_report(const char *per, int64_t iterations)
+{
+    struct counter_slot peers;
+    int npeers = nslots - 1;
+
+    if (my_slot != 0) {
+        return;
+    }
+    noise_stop();
+    while (wait(NULL) > 0) {
+    }
+
+    memset(&peers, 0, sizeof(peers));
+    for (int s = 1; s < nslots; s++) {
+        for (size_t c = 0; c < NCOUNTERS; c++) {
+            merge_status(&peers.status[c], slots[s].status[c], s == 1);
+            peers.value[c] += slots[s].value[c];
+        }
+        for (int c = 0; c < NCPU; c++) {
+            merge_status(&peers.cpu_status[c], slots[s].cpu_status[c], s == 1);
+            peers.cpu_value[c] += slots[s].cpu_value[c];
+        }
+    }
+
+    print_header("cpu", per, npeers);
+    for (int c = 0; c < NCPU; c++) {
+        printf("  %-28s", cpu_names[c]);
+        print_value(slots[0].cpu_status[c], slots[0].cpu_value[c], 1,
+                    iterations);
+        if (npeers > 0) {
+            print_value(peers.cpu_status[c], peers.cpu_value[c], npeers,
+                        iterations);
+        }
+        printf("\n");
+    }
+
+#ifdef __linux__
+    if (!bench_opts.perf) {
+        return;
+    }
+    print_header("perf counters", per, npeers);
+    for (size_t c = 0; c < NCOUNTERS; c++) {
+        printf("  %-28s", counters[c].name);
+        print_value(slots[0].status[c], slots[0].value[c], 1, iterations);
+        if (npeers > 0) {
+            print_value(peers.status[c], peers.value[c], npeers, iterations);
+        }
+        if (slots[0].status[c] == COUNTER_USER_ONLY ||
+                peers.status[c] == COUNTER_USER_ONLY) {
+            printf("  (user space only)");
+        }
+        printf("\n");
+    }
+#endif
+}
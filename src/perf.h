@@ -0,0 +1,58 @@
+/*
+    Performance counters and CPU accounting around the measured loop
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_PERF_H
+#define IPC_BENCH_PERF_H
+
+#include <stdint.h>
+
+/* Every process records its user and system CPU time, run queue wait and
+ * voluntary and involuntary context switches over the measured runs, and
+ * with --perf also cycles, instructions, cache, TLB and branch misses,
+ * context switches and page faults. The counts of forked peers go to a
+ * shared page, so perf_counters_init has to be called before fork with
+ * the number of peers. Counters the kernel or the hardware does not
+ * provide are reported as unavailable. */
+int perf_counters_init(int npeers);
+
+/* Open the counters of this process, slot 0 is the parent and peers use
+ * 1..npeers. They stay disabled until perf_counters_start. */
+void perf_counters_open(int slot);
+void perf_counters_start(void);
+void perf_counters_stop(void);
+
+/* Called by a peer after it completed done iterations, starts counting
+ * once the following ones belong to a measured run */
+void perf_counters_peer_mark(int64_t done, int64_t count);
+
+/* Wait for forked peers to exit, peer threads have to be joined before,
+ * and print the counts of the parent and the peer average, divided by the
+ * measured iterations of one peer */
+void perf_counters_report(const char *per, int64_t iterations);
+
+#endif
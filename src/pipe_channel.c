@@ -0,0 +1,178 @@
+/*
+    Anonymous pipes and named FIFOs with capacity and packet mode
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#define _GNU_SOURCE
+
+#include "pipe_channel.h"
+
+#include "bench.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct pipe_options pipe_opts = {
+    .fifo = 0,
+    .capacity = 0,
+    .packet = 0,
+};
+
+int pipe_parse_options(int *argc, char *argv[])
+{
+    pipe_opts.fifo = bench_take_option(argc, argv, "fifo") != NULL;
+    pipe_opts.packet = bench_take_option(argc, argv, "packet") != NULL;
+    if (bench_take_int_option(argc, argv, "pipe-size", 1,
+                              &pipe_opts.capacity)) {
+        return -1;
+    }
+#ifndef F_SETPIPE_SZ
+    if (pipe_opts.capacity || pipe_opts.packet) {
+        fprintf(stderr, "--pipe-size and --packet need Linux\n");
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+const char *pipe_usage(void)
+{
+    return "pipe options:\n"
+           "  --fifo           named FIFOs opened by path after the fork\n"
+           "                   instead of anonymous pipes\n"
+           "  --pipe-size=N    set the pipe capacity with F_SETPIPE_SZ\n"
+           "  --packet         O_DIRECT packet mode, a read returns at most\n"
+           "                   one write of up to PIPE_BUF octets\n";
+}
+
+void pipe_print(void)
+{
+    printf("pipe: %s", pipe_opts.fifo ? "fifo" : "anonymous");
+    if (pipe_opts.capacity) {
+        printf(", capacity %d", pipe_opts.capacity);
+    }
+    if (pipe_opts.packet) {
+        printf(", packet mode");
+    }
+    printf("\n");
+}
+
+/* Capacity and packet mode belong to the write end */
+static int configure(int fd)
+{
+#ifdef F_SETPIPE_SZ
+    if (pipe_opts.capacity &&
+            fcntl(fd, F_SETPIPE_SZ, pipe_opts.capacity) == -1) {
+        perror("fcntl F_SETPIPE_SZ");
+        return -1;
+    }
+    /* open() rejects O_DIRECT on a FIFO, fcntl() does not */
+    if (pipe_opts.packet &&
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT) == -1) {
+        perror("fcntl O_DIRECT");
+        return -1;
+    }
+#else
+    (void)fd;
+#endif
+    return 0;
+}
+
+int pipe_channel_create(struct pipe_channel *c, int n)
+{
+    if (pipe_opts.fifo) {
+        snprintf(c->path, sizeof(c->path), "/tmp/ipc-bench-fifo-%ld-%d",
+                 (long)getpid(), n);
+        unlink(c->path);
+        if (mkfifo(c->path, 0600) == -1) {
+            perror("mkfifo");
+            return -1;
+        }
+        return 0;
+    }
+
+    if (pipe(c->fds) == -1) {
+        perror("pipe");
+        return -1;
+    }
+    return configure(c->fds[1]);
+}
+
+int pipe_channel_open(struct pipe_channel *c, int end)
+{
+    int fd;
+
+    if (!pipe_opts.fifo) {
+        close(c->fds[!end]);
+        return c->fds[end];
+    }
+
+    fd = open(c->path, end ? O_WRONLY : O_RDONLY);
+    if (fd == -1) {
+        perror("open");
+        return -1;
+    }
+    /* both sides have it open now, either may remove the name */
+    if (unlink(c->path) == -1 && errno != ENOENT) {
+        perror("unlink");
+        return -1;
+    }
+    if (end && configure(fd)) {
+        return -1;
+    }
+    return fd;
+}
+
+int64_t pipe_channel_holds(int fd, int size)
+{
+#ifdef F_GETPIPE_SZ
+    int64_t page = sysconf(_SC_PAGESIZE), slots, len = size > 0 ? size : 1;
+    int capacity = fcntl(fd, F_GETPIPE_SZ);
+
+    if (capacity == -1) {
+        perror("fcntl F_GETPIPE_SZ");
+        return -1;
+    }
+    /* the pipe is a ring of page sized buffers; a write only goes into
+     * the last one if it fits there whole, and never in packet mode where
+     * every page is a packet of its own */
+    slots = capacity / page;
+    if (pipe_opts.packet) {
+        return slots / ((len + page - 1) / page);
+    }
+    if (len <= page) {
+        return slots * (page / len);
+    }
+    return capacity / len;
+#else
+    (void)fd;
+    (void)size;
+    return -1;
+#endif
+}
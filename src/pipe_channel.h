@@ -0,0 +1,65 @@
+/*
+    Anonymous pipes and named FIFOs with capacity and packet mode
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_PIPE_CHANNEL_H
+#define IPC_BENCH_PIPE_CHANNEL_H
+
+#include <stdint.h>
+
+struct pipe_options {
+    int fifo;     /* named FIFOs opened by path instead of pipe() */
+    int capacity; /* F_SETPIPE_SZ, 0 keeps the default */
+    int packet;   /* O_DIRECT packet mode, every write is one message */
+};
+
+extern struct pipe_options pipe_opts;
+
+/* Take --fifo, --pipe-size and --packet out of argv */
+int pipe_parse_options(int *argc, char *argv[]);
+const char *pipe_usage(void);
+void pipe_print(void);
+
+struct pipe_channel {
+    int fds[2];    /* read and write end of an anonymous pipe */
+    char path[64]; /* or the FIFO both ends are opened from */
+};
+
+/* Create channel number n before the fork */
+int pipe_channel_create(struct pipe_channel *c, int n);
+/* Descriptor of the read (end 0) or write (end 1) side, called after the
+ * fork. A FIFO is opened by path like an unrelated process would, which
+ * blocks until the other side opens it too, and is unlinked afterwards.
+ * Of an anonymous pipe the other end is closed, so either way a side sees
+ * end of file or EPIPE once the other one exits. */
+int pipe_channel_open(struct pipe_channel *c, int end);
+
+/* How many writes of size octets the pipe of fd buffers before the next
+ * one blocks, -1 where its capacity cannot be read */
+int64_t pipe_channel_holds(int fd, int size);
+
+#endif
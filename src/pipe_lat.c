@@ -33,113 +33,136 @@
 #include <time.h>
 #include <unistd.h>
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
+#include "bench.h"
+#include "memory.h"
+#include "perf.h"
+#include "pipeline.h"
+#include "pipe_channel.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
+#include "workload.h"
 
 int main(int argc, char *argv[])
 {
-    int ofds[2];
-    int ifds[2];
+    struct pipe_channel ochan, ichan;
+    int ofd, ifd;
 
     int size;
     char *buf;
-    int64_t count, i, delta;
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop;
-#else
-    struct timeval start, stop;
-#endif
-
-    if (argc != 3) {
-        printf("usage: pipe_lat <message-size> <roundtrip-count>\n");
+    int64_t count, i, delta, start;
+    int run;
+    struct run_stats stats;
+    struct pipeline pl;
+    int step;
+
+    if (pipe_parse_options(&argc, argv) ||
+            pipeline_parse_options(&argc, argv) ||
+            bench_parse_options(&argc, argv) || argc != 3) {
+        printf("usage: pipe_lat [options] <message-size> <roundtrip-count>\n"
+               "%s%s%s",
+               pipe_usage(), pipeline_usage(), bench_usage());
         return 1;
     }
 
     size = atoi(argv[1]);
     count = atol(argv[2]);
 
-    buf = malloc(size);
+    buf = memory_alloc(size);
     if (buf == NULL) {
-        perror("malloc");
         return 1;
     }
 
     printf("message size: %i octets\n", size);
     printf("roundtrip count: %li\n", count);
 
-    if (pipe(ofds) == -1) {
-        perror("pipe");
+    pipe_print();
+    pipeline_print();
+    if (pipe_channel_create(&ochan, 0) || pipe_channel_create(&ichan, 1)) {
         return 1;
     }
 
-    if (pipe(ifds) == -1) {
-        perror("pipe");
+    if (run_stats_init(&stats, "latency", "ns", bench_opts.runs) ||
+            pipeline_init(&pl, count, 0)) {
+        return 1;
+    }
+
+    if (perf_counters_init(1)) {
         return 1;
     }
 
     if (!fork()) { /* child */
-        for (i = 0; i < count; i++) {
+        /* the same order as the parent, so opening FIFOs cannot deadlock */
+        ifd = pipe_channel_open(&ichan, 0);
+        ofd = pipe_channel_open(&ochan, 1);
+        if (ifd == -1 || ofd == -1) {
+            return 1;
+        }
+        realtime_enter_peer();
+        perf_counters_open(1);
+        bench_prefault(buf, size);
+        for (i = 0; i < bench_peer_iterations(count); i++) {
+            perf_counters_peer_mark(i, count);
 
-            if (read(ifds[0], buf, size) != size) {
+            if (read_full(ifd, buf, size)) {
                 perror("read");
                 return 1;
             }
 
-            if (write(ofds[1], buf, size) != size) {
+            if (write(ofd, buf, size) != size) {
                 perror("write");
                 return 1;
             }
         }
+        perf_counters_stop();
     } else { /* parent */
-
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-            perror("clock_gettime");
+        ifd = pipe_channel_open(&ichan, 1);
+        ofd = pipe_channel_open(&ochan, 0);
+        if (ifd == -1 || ofd == -1) {
             return 1;
         }
-#else
-        if (gettimeofday(&start, NULL) == -1) {
-            perror("gettimeofday");
+        if (pipeline_check_fits(pipe_channel_holds(ifd, size), size,
+                                "pipe")) {
             return 1;
         }
-#endif
+        bench_prefault(buf, size);
 
-        for (i = 0; i < count; i++) {
-
-            if (write(ifds[1], buf, size) != size) {
-                perror("write");
-                return 1;
+        perf_counters_open(0);
+        for (run = bench_first_run(); run < bench_total_runs(); run++) {
+            if (run == bench_opts.warmup_runs) {
+                perf_counters_start();
             }
-
-            if (read(ofds[0], buf, size) != size) {
-                perror("read");
-                return 1;
+            pipeline_start(&pl);
+            start = now_ns();
+
+            while ((step = pipeline_next(&pl, run)) >= 0) {
+                if (step) {
+                    pipeline_sent(&pl);
+                    if (write(ifd, buf, size) != size) {
+                        perror("write");
+                        return 1;
+                    }
+                    continue;
+                }
+
+                if (read_full(ofd, buf, size)) {
+                    perror("read");
+                    return 1;
+                }
+                pipeline_received(&pl, run);
             }
-        }
-
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-            perror("clock_gettime");
-            return 1;
-        }
 
-        delta = ((stop.tv_sec - start.tv_sec) * 1000000000 +
-                 (stop.tv_nsec - start.tv_nsec));
-
-#else
-        if (gettimeofday(&stop, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
+            delta = now_ns() - start;
+            if (bench_warmup_done(run, pl.sent, delta)) {
+                continue;
+            }
+            run_stats_add(&stats, run, pipeline_latency(&pl, run, delta));
         }
+        perf_counters_stop();
 
-        delta =
-            (stop.tv_sec - start.tv_sec) * 1000000000 + (stop.tv_usec - start.tv_usec) * 1000;
-
-#endif
-
-        printf("average latency: %li ns\n", delta / (count * 2));
+        run_stats_report(&stats);
+        pipeline_report(&pl);
+        perf_counters_report("roundtrip", count * bench_opts.runs);
     }
 
     return 0;
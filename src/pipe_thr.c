@@ -26,6 +26,7 @@
     OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,100 +34,194 @@
 #include <time.h>
 #include <unistd.h>
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
+#include "bench.h"
+#include "memory.h"
+#include "payload.h"
+#include "perf.h"
+#include "pipe_channel.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
+#include "workload.h"
 
 int main(int argc, char *argv[])
 {
-    int fds[2];
+    struct pipe_channel chan;
+    int fd;
+    ssize_t len;
 
     int size;
     char *buf;
-    int64_t count, i, delta;
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop;
-#else
-    struct timeval start, stop;
-#endif
-
-    if (argc != 3) {
-        printf("usage: pipe_thr <message-size> <message-count>\n");
+    int64_t count, i, delta, bytes, start, t0, seq = 0;
+    struct workload wl;
+    size_t *sizes, msg_size;
+    struct size_histogram hist;
+    int run;
+    struct run_stats msg_stats, thr_stats;
+
+    if (pipe_parse_options(&argc, argv) ||
+            payload_parse_options(&argc, argv) ||
+            bench_parse_options(&argc, argv) || argc != 3) {
+        printf("usage: pipe_thr [options] <message-size> <message-count>\n"
+               "%s%s%s%s",
+               workload_usage(), pipe_usage(), payload_usage(), bench_usage());
         return 1;
     }
 
-    size = atoi(argv[1]);
+    if (workload_parse(&wl, argv[1])) {
+        return 1;
+    }
+    size = wl.max_size;
+    /* in packet mode a message is one write, and a write larger than
+     * PIPE_BUF is split into several packets */
+    if (pipe_opts.packet && wl.kind != WORKLOAD_FIXED && size > PIPE_BUF) {
+        fprintf(stderr, "--packet carries at most %d octets per message\n",
+                PIPE_BUF);
+        return 1;
+    }
     count = atol(argv[2]);
 
-    buf = malloc(size);
+    sizes = workload_sizes(&wl, count);
+    if (sizes == NULL) {
+        return 1;
+    }
+    size_histogram_reset(&hist);
+    for (bytes = 0, i = 0; i < count; i++) {
+        bytes += sizes[i];
+    }
+
+    if (run_stats_init(&msg_stats, "throughput", "msg/s", bench_opts.runs) ||
+            run_stats_init(&thr_stats, "throughput", "Mb/s",
+                           bench_opts.runs)) {
+        return 1;
+    }
+
+    buf = memory_alloc(sizeof(frame_header_t) + size);
     if (buf == NULL) {
-        perror("malloc");
         return 1;
     }
 
-    printf("message size: %i octets\n", size);
+    workload_print(&wl);
     printf("message count: %li\n", count);
 
-    if (pipe(fds) == -1) {
-        perror("pipe");
+    pipe_print();
+    payload_print();
+    if (pipe_channel_create(&chan, 0) || payload_init(wl.min_size)) {
+        return 1;
+    }
+
+    if (perf_counters_init(1)) {
         return 1;
     }
 
     if (!fork()) {
         /* child */
-
-        for (i = 0; i < count; i++) {
-            if (read(fds[0], buf, size) != size) {
-                perror("read");
-                return 1;
+        fd = pipe_channel_open(&chan, 0);
+        if (fd == -1) {
+            return 1;
+        }
+        realtime_enter_peer();
+        perf_counters_open(1);
+        bench_prefault(buf, sizeof(frame_header_t) + size);
+
+        if (wl.kind == WORKLOAD_FIXED) {
+            for (i = 0; i < bench_peer_iterations(count); i++) {
+                perf_counters_peer_mark(i, count);
+                if (read_full(fd, buf, size)) {
+                    perror("read");
+                    return 1;
+                }
+                if (payload_verify) {
+                    payload_check(buf, size, i);
+                }
             }
+            perf_counters_stop();
+        } else {
+            for (i = 0; i < bench_peer_iterations(count); i++) {
+                perf_counters_peer_mark(i, count);
+                /* packets keep message boundaries themselves */
+                if (pipe_opts.packet) {
+                    len = read(fd, buf, size);
+                } else {
+                    len = read_frame(fd, buf, size);
+                }
+                if (len != (ssize_t)sizes[i % count]) {
+                    perror("read");
+                    return 1;
+                }
+                if (payload_verify) {
+                    payload_check(pipe_opts.packet ? buf
+                                                   : buf + sizeof(frame_header_t),
+                                  len, i);
+                }
+            }
+            perf_counters_stop();
         }
     } else {
         /* parent */
-
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-            perror("clock_gettime");
+        fd = pipe_channel_open(&chan, 1);
+        if (fd == -1) {
             return 1;
         }
-#else
-        if (gettimeofday(&start, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
-        }
-#endif
+        bench_prefault(buf, sizeof(frame_header_t) + size);
 
-        for (i = 0; i < count; i++) {
-            if (write(fds[1], buf, size) != size) {
-                perror("write");
-                return 1;
+        perf_counters_open(0);
+        for (run = bench_first_run(); run < bench_total_runs(); run++) {
+            if (run == bench_opts.warmup_runs) {
+                size_histogram_reset(&hist);
+                perf_counters_start();
+            }
+            start = now_ns();
+
+            if (wl.kind == WORKLOAD_FIXED) {
+                for (i = 0; bench_run_continues(run, i, count); i++) {
+                    if (payload_verify) {
+                        payload_fill(buf, size, seq++);
+                    }
+                    if (write(fd, buf, size) != size) {
+                        perror("write");
+                        return 1;
+                    }
+                }
+            } else {
+                for (i = 0; bench_run_continues(run, i, count); i++) {
+                    msg_size = sizes[bench_message_index(run, i, count)];
+                    if (payload_verify) {
+                        payload_fill(pipe_opts.packet ? buf
+                                                      : buf + sizeof(frame_header_t),
+                                     msg_size, seq++);
+                    }
+                    t0 = now_ns();
+                    if (pipe_opts.packet ?
+                            write(fd, buf, msg_size) != (ssize_t)msg_size :
+                            write_frame(fd, buf, msg_size)) {
+                        perror("write");
+                        return 1;
+                    }
+                    size_histogram_add(&hist, msg_size, now_ns() - t0);
+                }
             }
-        }
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-            perror("clock_gettime");
-            return 1;
+            delta = now_ns() - start;
+            if (bench_warmup_done(run, i, delta)) {
+                continue;
+            }
+            delta /= 1000;
+            run_stats_add(&msg_stats, run, (count * 1000000) / delta);
+            run_stats_add(&thr_stats, run, (bytes * 8) / delta);
         }
+        perf_counters_stop();
 
-        delta = ((stop.tv_sec - start.tv_sec) * 1000000 +
-                 (stop.tv_nsec - start.tv_nsec) / 1000);
-
-#else
-        if (gettimeofday(&stop, NULL) == -1) {
-            perror("gettimeofday");
+        run_stats_report(&msg_stats);
+        run_stats_report(&thr_stats);
+        if (wl.kind != WORKLOAD_FIXED) {
+            printf("per message send time by size:\n");
+            size_histogram_print(&hist, 1);
+        }
+        perf_counters_report("message", count * bench_opts.runs);
+        if (payload_report()) {
             return 1;
         }
-
-        delta =
-            (stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
-
-#endif
-
-        printf("average throughput: %li msg/s\n", (count * 1000000) / delta);
-        printf("average throughput: %li Mb/s\n",
-               (((count * 1000000) / delta) * size * 8) / 1000000);
     }
 
     return 0;
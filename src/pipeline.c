@@ -0,0 +1,186 @@
+/*
+    Several requests in flight for the latency benchmarks
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "pipeline.h"
+
+#include "bench.h"
+#include "noise.h"
+#include "timing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+/* A socket buffer is charged for the allocation holding a message with
+ * room for headers and the shared info, a power of two, and the sk_buff */
+#define SKB_DATA_OVERHEAD 576
+#define SKB_OVERHEAD 256
+
+int pipeline_window = 1;
+
+int pipeline_parse_options(int *argc, char *argv[])
+{
+    return bench_take_int_option(argc, argv, "window", 1, &pipeline_window);
+}
+
+const char *pipeline_usage(void)
+{
+    return "pipelining options:\n"
+           "  --window=K       keep K requests in flight (default 1); the\n"
+           "                   responses of K requests have to fit into\n"
+           "                   the transport's buffers\n";
+}
+
+void pipeline_print(void)
+{
+    if (pipeline_window > 1) {
+        printf("window: %d requests in flight\n", pipeline_window);
+    }
+}
+
+int pipeline_check_fits(int64_t holds, int size, const char *what)
+{
+    if (pipeline_window == 1 || holds < 0 || pipeline_window <= holds) {
+        return 0;
+    }
+    fprintf(stderr, "a window of %d messages of %d octets does not fit "
+                    "into the %s, there is room for %lld\n",
+            pipeline_window, size, what, (long long)holds);
+    return -1;
+}
+
+int64_t pipeline_socket_holds(int fd, int optname, int size)
+{
+    int bytes;
+    socklen_t len = sizeof(bytes);
+    int64_t charged = 1;
+
+    if (getsockopt(fd, SOL_SOCKET, optname, &bytes, &len) == -1) {
+        perror("getsockopt");
+        return -1;
+    }
+    while (charged < (int64_t)size + SKB_DATA_OVERHEAD) {
+        charged <<= 1;
+    }
+    return bytes / (charged + SKB_OVERHEAD);
+}
+
+int pipeline_init(struct pipeline *p, int64_t count, int stamp)
+{
+    p->count = count;
+    p->lost_total = 0;
+    p->recorded = 0;
+    p->record = pipeline_window > 1 || noise_enabled();
+    p->stamp = stamp || p->record;
+    p->stamps = malloc(pipeline_window * sizeof(*p->stamps));
+    p->rtts = NULL;
+    if (p->record) {
+        p->rtts = malloc(count * bench_opts.runs * sizeof(*p->rtts));
+    }
+    if (p->stamps == NULL || (p->record && p->rtts == NULL)) {
+        perror("malloc");
+        return -1;
+    }
+    return run_stats_init(&p->rate, "throughput", "roundtrip/s",
+                          bench_opts.runs);
+}
+
+void pipeline_start(struct pipeline *p)
+{
+    p->sent = 0;
+    p->received = 0;
+    p->rtt_sum = 0;
+    p->lost = 0;
+}
+
+int pipeline_next(const struct pipeline *p, int run)
+{
+    if (bench_run_continues(run, p->sent, p->count) &&
+            p->sent - p->received < pipeline_window) {
+        return 1;
+    }
+    return p->received < p->sent ? 0 : -1;
+}
+
+void pipeline_sent(struct pipeline *p)
+{
+    if (p->stamp) {
+        p->stamps[p->sent % pipeline_window] = now_ns();
+    }
+    p->sent++;
+}
+
+int64_t pipeline_received(struct pipeline *p, int run)
+{
+    int64_t rtt = 0;
+
+    if (p->stamp) {
+        rtt = now_ns() - p->stamps[p->received % pipeline_window];
+        p->rtt_sum += rtt;
+        if (p->rtts != NULL && run >= bench_opts.warmup_runs) {
+            p->rtts[p->recorded++] = rtt;
+        }
+    }
+    p->received++;
+    return rtt;
+}
+
+void pipeline_lost(struct pipeline *p, int run)
+{
+    p->lost++;
+    if (run >= bench_opts.warmup_runs) {
+        p->lost_total++;
+    }
+    p->received++;
+}
+
+int64_t pipeline_latency(struct pipeline *p, int run, int64_t delta)
+{
+    int64_t answered = p->received - p->lost;
+
+    run_stats_add(&p->rate, run, answered * 1000000000.0 / delta);
+    if (pipeline_window > 1 || p->lost > 0) {
+        return answered > 0 ? p->rtt_sum / (answered * 2) : 0;
+    }
+    return delta / (p->received * 2);
+}
+
+void pipeline_report(struct pipeline *p)
+{
+    if (pipeline_window > 1) {
+        run_stats_report(&p->rate);
+    }
+    if (p->lost_total > 0) {
+        printf("lost: %lld of %lld\n", (long long)p->lost_total,
+               (long long)(p->count * bench_opts.runs));
+    }
+    if (p->record) {
+        percentiles_report("round trip", p->rtts, p->recorded, "ns");
+        histogram_report("round trip", p->rtts, p->recorded, "ns");
+    }
+}
@@ -0,0 +1,108 @@
+/*
+    Several requests in flight for the latency benchmarks
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_PIPELINE_H
+#define IPC_BENCH_PIPELINE_H
+
+#include <stdint.h>
+
+#include "stats.h"
+
+/* Requests in flight, 1 without --window */
+extern int pipeline_window;
+
+/* Per-run state of a latency loop with a window of requests in flight.
+ * Responses have to come back in the order the requests were sent. */
+struct pipeline {
+    int64_t sent;     /* requests sent in this run */
+    int64_t received; /* responses received in this run */
+    int64_t rtt_sum;  /* round trips of this run */
+    int64_t lost;     /* requests of this run written off */
+    int64_t lost_total; /* and of all measured runs */
+    int stamp;        /* time every request, always done with a window */
+    int record;       /* keep every round trip, with a window or noise */
+    int64_t *stamps;  /* send times, a ring of window entries */
+    int64_t *rtts;    /* round trips of all measured requests */
+    int64_t recorded; /* entries of rtts */
+    int64_t count;
+    struct run_stats rate; /* roundtrips per second of each run */
+};
+
+/* Take --window=K out of argv */
+int pipeline_parse_options(int *argc, char *argv[]);
+const char *pipeline_usage(void);
+void pipeline_print(void);
+
+/* Fails when the responses to a window of requests of size octets do not
+ * fit into a buffer holding holds of them, where parent and child would
+ * block each other on writing or datagrams be dropped. what names the
+ * buffer; a negative holds is not known and passes. */
+int pipeline_check_fits(int64_t holds, int size, const char *what);
+/* How many messages of size octets the SO_SNDBUF or SO_RCVBUF, given as
+ * optname, of a socket holds, with what the kernel charges per message
+ * beyond the payload; -1 if it cannot be read */
+int64_t pipeline_socket_holds(int fd, int optname, int size);
+
+/* stamp asks for round trips even with a window of 1. With a window or
+ * --noise every round trip is kept for percentiles and a histogram. */
+int pipeline_init(struct pipeline *p, int64_t count, int stamp);
+
+/* The loop of one run, with the benchmark's own send and receive:
+ *
+ *     pipeline_start(&pl);
+ *     while ((step = pipeline_next(&pl, run)) >= 0) {
+ *         if (step) {
+ *             pipeline_sent(&pl);
+ *             ... send request pl.sent - 1 ...
+ *         } else {
+ *             ... receive response pl.received ...
+ *             pipeline_received(&pl, run);
+ *         }
+ *     }
+ *
+ * Requests are sent while the run continues and fewer than the window are
+ * outstanding, then the remaining responses are drained. */
+void pipeline_start(struct pipeline *p);
+int pipeline_next(const struct pipeline *p, int run);
+void pipeline_sent(struct pipeline *p);
+/* Returns the round trip of the response, 0 when not timed */
+int64_t pipeline_received(struct pipeline *p, int run);
+/* Writes off the oldest outstanding request instead, its response is not
+ * coming; a loop that may lose requests has to stamp them */
+void pipeline_lost(struct pipeline *p, int run);
+
+/* Average one way latency of a measured run that took delta ns: half the
+ * mean round trip with a window or losses, which is what
+ * delta / (2 * count) measures otherwise. Also records the rate of the
+ * run. */
+int64_t pipeline_latency(struct pipeline *p, int run, int64_t delta);
+/* With a window, the rate and percentiles and a histogram of the
+ * measured round trips, and the requests lost if there were any */
+void pipeline_report(struct pipeline *p);
+
+#endif
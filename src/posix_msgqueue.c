@@ -1,5 +1,5 @@
 /*
-    Measure latency of System V message queue
+    Measure latency and throughput of POSIX message queues
 
 
     Copyright (c) 2019 Seppo Takalo <seppo.takalo@arm.com>
@@ -27,54 +27,348 @@
     OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h> /* Defines O_* constants */
+#include <mqueue.h>
+#include <poll.h>
+#include <semaphore.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/stat.h> /* Defines mode constants */
+#include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
-#include <fcntl.h> /* Defines O_* constants */
-#include <sys/stat.h> /* Defines mode constants */
-#include <mqueue.h>
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
+#include "bench.h"
+#include "memory.h"
+#include "perf.h"
+#include "pipeline.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
+#include "workload.h"
+
+#define MAX_PRIORITIES 32
+
+/* mq_notify signal */
+#define NOTIFY_SIGNAL SIGUSR1
+
+enum receive_method {
+    RECEIVE_BLOCKING, /* mq_receive */
+    RECEIVE_TIMED,    /* mq_timedreceive */
+    RECEIVE_POLL,     /* poll on the queue descriptor */
+    RECEIVE_EPOLL,
+    RECEIVE_SIGNAL,   /* mq_notify with SIGEV_SIGNAL */
+    RECEIVE_THREAD,   /* mq_notify with SIGEV_THREAD */
+};
+
+static const char *receive_names[] = {
+    [RECEIVE_BLOCKING] = "blocking",
+    [RECEIVE_TIMED] = "timed",
+    [RECEIVE_POLL] = "poll",
+    [RECEIVE_EPOLL] = "epoll",
+    [RECEIVE_SIGNAL] = "signal",
+    [RECEIVE_THREAD] = "thread",
+};
+
+static enum receive_method method = RECEIVE_BLOCKING;
+static int timeout_us = 1000;
+
+/* Written by both processes, printed by the parent */
+struct report {
+    int64_t timeouts[2];               /* expired timed receives per side */
+    int64_t received[MAX_PRIORITIES];  /* measured messages per priority */
+    int64_t delay_ns[MAX_PRIORITIES];  /* and their time spent queued */
+};
+
+struct receiver {
+    mqd_t mq;
+    int epfd;
+    sem_t ready;       /* posted by the SIGEV_THREAD notification */
+    int64_t *timeouts;
+};
+
+static void notified(union sigval sv)
+{
+    sem_post(sv.sival_ptr);
+}
+
+/* Open the queue name again for receiving. The descriptors from before
+ * the fork share their flags with the other process, and the notification
+ * methods need a non-blocking one. */
+static int receiver_init(struct receiver *r, const char *name,
+                         int64_t *timeouts)
+{
+    int notify = method == RECEIVE_SIGNAL || method == RECEIVE_THREAD;
+    struct epoll_event ev;
+
+    r->timeouts = timeouts;
+    r->mq = mq_open(name, O_RDONLY | (notify ? O_NONBLOCK : 0));
+    if (r->mq == (mqd_t)-1) {
+        perror("mq_open");
+        return -1;
+    }
+    if (method == RECEIVE_THREAD && sem_init(&r->ready, 0, 0)) {
+        perror("sem_init");
+        return -1;
+    }
+    if (method == RECEIVE_EPOLL) {
+        r->epfd = epoll_create1(0);
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        if (r->epfd == -1 || epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->mq, &ev)) {
+            perror("epoll");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Ask for a notification and wait for it. The notification only fires
+ * when a message arrives at an empty queue, so a message that came in
+ * before registering is picked up by the caller trying again. */
+static int wait_notification(struct receiver *r)
+{
+    struct sigevent sev;
+    struct mq_attr attr;
+    sigset_t set;
+
+    memset(&sev, 0, sizeof(sev));
+    if (method == RECEIVE_SIGNAL) {
+        sev.sigev_notify = SIGEV_SIGNAL;
+        sev.sigev_signo = NOTIFY_SIGNAL;
+    } else {
+        sev.sigev_notify = SIGEV_THREAD;
+        sev.sigev_notify_function = notified;
+        sev.sigev_value.sival_ptr = &r->ready;
+    }
+    /* EBUSY: still registered from a wait that found a message anyway */
+    if (mq_notify(r->mq, &sev) && errno != EBUSY) {
+        perror("mq_notify");
+        return -1;
+    }
+    if (mq_getattr(r->mq, &attr)) {
+        perror("mq_getattr");
+        return -1;
+    }
+    if (attr.mq_curmsgs > 0) {
+        return 0;
+    }
+
+    if (method == RECEIVE_SIGNAL) {
+        sigemptyset(&set);
+        sigaddset(&set, NOTIFY_SIGNAL);
+        while (sigwaitinfo(&set, NULL) == -1) {
+            if (errno != EINTR) {
+                perror("sigwaitinfo");
+                return -1;
+            }
+        }
+        return 0;
+    }
+    while (sem_wait(&r->ready)) {
+        if (errno != EINTR) {
+            perror("sem_wait");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static ssize_t receive(struct receiver *r, char *buf, size_t len,
+                       unsigned *prio)
+{
+    struct pollfd pfd = {.fd = r->mq, .events = POLLIN};
+    struct epoll_event ev;
+    struct timespec deadline;
+    ssize_t got;
+
+    switch (method) {
+    case RECEIVE_BLOCKING:
+        break;
+    case RECEIVE_TIMED:
+        for (;;) {
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += (long)timeout_us * 1000;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000;
+            deadline.tv_nsec %= 1000000000;
+            got = mq_timedreceive(r->mq, buf, len, prio, &deadline);
+            if (got != -1 || errno != ETIMEDOUT) {
+                return got;
+            }
+            (*r->timeouts)++;
+        }
+    case RECEIVE_POLL:
+        if (poll(&pfd, 1, -1) == -1) {
+            return -1;
+        }
+        break;
+    case RECEIVE_EPOLL:
+        if (epoll_wait(r->epfd, &ev, 1, -1) == -1) {
+            return -1;
+        }
+        break;
+    case RECEIVE_SIGNAL:
+    case RECEIVE_THREAD:
+        for (;;) {
+            got = mq_receive(r->mq, buf, len, prio);
+            if (got != -1 || errno != EAGAIN) {
+                return got;
+            }
+            if (wait_notification(r)) {
+                return -1;
+            }
+        }
+    }
+    return mq_receive(r->mq, buf, len, prio);
+}
+
+static int parse_options(int *argc, char *argv[], int *throughput,
+                         int *depth, int *priorities)
+{
+    const char *mode = bench_take_option(argc, argv, "mode");
+    const char *recv = bench_take_option(argc, argv, "receive");
+
+    *throughput = mode != NULL && strcmp(mode, "throughput") == 0;
+    if (mode != NULL && !*throughput && strcmp(mode, "latency") != 0) {
+        fprintf(stderr, "bad value for --mode: '%s'\n", mode);
+        return -1;
+    }
+    if (recv != NULL) {
+        for (method = 0; method <= RECEIVE_THREAD; method++) {
+            if (strcmp(recv, receive_names[method]) == 0) {
+                break;
+            }
+        }
+        if (method > RECEIVE_THREAD) {
+            fprintf(stderr, "bad value for --receive: '%s'\n", recv);
+            return -1;
+        }
+    }
+    if (bench_take_int_option(argc, argv, "depth", 1, depth) ||
+            bench_take_int_option(argc, argv, "priorities", 1, priorities) ||
+            bench_take_int_option(argc, argv, "timeout", 1, &timeout_us)) {
+        return -1;
+    }
+    if (*priorities > MAX_PRIORITIES) {
+        fprintf(stderr, "at most %d priorities\n", MAX_PRIORITIES);
+        return -1;
+    }
+    if (pipeline_parse_options(argc, argv)) {
+        return -1;
+    }
+    /* responses must come back in order, and both queues must hold the
+     * whole window or parent and child block each other */
+    if (pipeline_window > 1 &&
+            (*throughput || *priorities > 1 || pipeline_window > *depth)) {
+        fprintf(stderr, "--window needs --mode=latency, one priority and "
+                        "a --depth of at least the window\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void print_delays(const struct report *rep, int priorities)
+{
+    printf("queueing delay by priority:\n");
+    printf("  %-10s %12s %14s\n", "priority", "messages", "average (ns)");
+    for (int p = priorities - 1; p >= 0; p--) {
+        printf("  %-10d %12lli %14.0f\n", p, (long long)rep->received[p],
+               rep->received[p] ? (double)rep->delay_ns[p] / rep->received[p]
+                                : 0.0);
+    }
+}
 
 int main(int argc, char *argv[])
 {
     mqd_t mq_up;
     mqd_t mq_down;
+    struct receiver rx;
+    struct report *rep;
+    sigset_t set;
 
-    int size;
-    int64_t count, i, delta;
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop;
-#else
-    struct timeval start, stop;
-#endif
+    int size, throughput, depth = 10, priorities = 1, stamped;
+    unsigned prio;
+    ssize_t len;
+    int64_t count, i, delta, bytes, start, t0 = 0, sent, rtt;
+    struct workload wl;
+    size_t *sizes, msg_size;
+    struct size_histogram hist;
+    int run;
+    struct run_stats stats, msg_stats, thr_stats;
+    struct pipeline pl;
+    int step;
 
-    if (argc != 3) {
-        printf("usage: %s <message-size> <roundtrip-count>\n", argv[0]);
+    if (parse_options(&argc, argv, &throughput, &depth, &priorities) ||
+            bench_parse_options(&argc, argv) || argc != 3) {
+        printf("usage: %s [options] <message-size> <count>\n"
+               "  --mode=MODE      latency (roundtrips, default) or throughput\n"
+               "                   (one way messages)\n"
+               "  --depth=N        queue depth, mq_maxmsg (default 10)\n"
+               "  --priorities=N   send message i with priority i %% N\n"
+               "  --receive=M      blocking (default), timed, poll, epoll,\n"
+               "                   signal or thread (mq_notify)\n"
+               "  --timeout=US     timeout of timed receives (default 1000)\n"
+               "%s%s%s",
+               argv[0], workload_usage(), pipeline_usage(), bench_usage());
         return 1;
     }
 
-    size = atoi(argv[1]);
+    if (workload_parse(&wl, argv[1])) {
+        return 1;
+    }
+    size = wl.max_size;
     count = atol(argv[2]);
 
-    void *buf = malloc(size);
+    sizes = workload_sizes(&wl, count);
+    if (sizes == NULL) {
+        return 1;
+    }
+    size_histogram_reset(&hist);
+    for (bytes = 0, i = 0; i < count; i++) {
+        bytes += sizes[i];
+    }
+    /* messages carry their send time for the delay by priority */
+    stamped = throughput && wl.min_size >= sizeof(int64_t);
+
+    if (run_stats_init(&stats, "latency", "ns", bench_opts.runs) ||
+            pipeline_init(&pl, count, wl.kind != WORKLOAD_FIXED) ||
+            run_stats_init(&msg_stats, "throughput", "msg/s",
+                           bench_opts.runs) ||
+            run_stats_init(&thr_stats, "throughput", "Mb/s",
+                           bench_opts.runs)) {
+        return 1;
+    }
+
+    void *buf = memory_alloc(size);
     if (buf == NULL) {
-        perror("malloc");
         return 1;
     }
+    rep = mmap(NULL, sizeof(*rep), PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (rep == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(rep, 0, sizeof(*rep));
 
-    printf("message size: %i octets\n", size);
-    printf("roundtrip count: %li\n", count);
+    workload_print(&wl);
+    printf("%s count: %li\n", throughput ? "message" : "roundtrip", count);
+    printf("queue depth: %d, priorities: %d, receive: %s\n", depth,
+           priorities, receive_names[method]);
+    pipeline_print();
 
     /* Create message queue */
     struct mq_attr attr;
     attr.mq_flags = 0;
-    attr.mq_maxmsg = 10;
+    attr.mq_maxmsg = depth;
     attr.mq_msgsize = size;
     
     mq_unlink("/UP");
@@ -84,67 +378,150 @@ int main(int argc, char *argv[])
 
     if ((-1 == mq_up) || (-1 == mq_down)) {
         perror("open_mq");
+        if (errno == EINVAL) {
+            fprintf(stderr, "depth and message size are limited by "
+                            "/proc/sys/fs/mqueue/msg_max and msgsize_max\n");
+        }
+        return 1;
+    }
+
+    /* taken with sigwaitinfo, inherited by the child */
+    sigemptyset(&set);
+    sigaddset(&set, NOTIFY_SIGNAL);
+    sigprocmask(SIG_BLOCK, &set, NULL);
+
+    if (perf_counters_init(1)) {
         return 1;
     }
 
     if (!fork()) { /* child */
-        for (i = 0; i < count; i++) {
-            if (mq_receive(mq_down, buf, size, NULL) == -1) {
+        if (receiver_init(&rx, "/DOWN", &rep->timeouts[1])) {
+            return 1;
+        }
+        realtime_enter_peer();
+        perf_counters_open(1);
+        bench_prefault(buf, size);
+        for (i = 0; i < bench_peer_iterations(count); i++) {
+            perf_counters_peer_mark(i, count);
+            if ((len = receive(&rx, buf, size, &prio)) == -1) {
                 perror("mq_receive");
                 return 1;
             }
 
-            if (mq_send(mq_up, buf, size, 0) == -1) {
+            if (throughput) {
+                if (stamped && i >= bench_peer_measured_start(count)) {
+                    memcpy(&sent, buf, sizeof(sent));
+                    rep->received[prio]++;
+                    rep->delay_ns[prio] += now_ns() - sent;
+                }
+                continue;
+            }
+            if (mq_send(mq_up, buf, len, prio) == -1) {
                 perror("mq_send");
                 return 1;
             }
         }
+        perf_counters_stop();
     } else { /* parent */
-
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-            perror("clock_gettime");
-            return 1;
-        }
-#else
-        if (gettimeofday(&start, NULL) == -1) {
-            perror("gettimeofday");
+        if (!throughput && receiver_init(&rx, "/UP", &rep->timeouts[0])) {
             return 1;
         }
-#endif
+        bench_prefault(buf, size);
 
-        for (i = 0; i < count; i++) {
-            if (mq_send(mq_down, buf, size, 0) == -1) {
-                perror("mq_send");
-                return 1;
+        perf_counters_open(0);
+        for (run = bench_first_run(); run < bench_total_runs(); run++) {
+            if (run == bench_opts.warmup_runs) {
+                size_histogram_reset(&hist);
+                perf_counters_start();
             }
-            if (mq_receive(mq_up, buf, size, NULL) == -1) {
-                perror("mq_receive");
-                return 1;
+            start = now_ns();
+
+            if (!throughput) {
+                pipeline_start(&pl);
+                while ((step = pipeline_next(&pl, run)) >= 0) {
+                    if (step) {
+                        pipeline_sent(&pl);
+                        i = pl.sent - 1;
+                        if (mq_send(mq_down, buf, sizes[i % count],
+                                    i % priorities) == -1) {
+                            perror("mq_send");
+                            return 1;
+                        }
+                        continue;
+                    }
+                    if (receive(&rx, buf, size, NULL) == -1) {
+                        perror("mq_receive");
+                        return 1;
+                    }
+                    rtt = pipeline_received(&pl, run);
+                    if (wl.kind != WORKLOAD_FIXED) {
+                        size_histogram_add(&hist,
+                                           sizes[(pl.received - 1) % count],
+                                           rtt);
+                    }
+                }
+                i = pl.sent;
+            } else {
+                for (i = 0; bench_run_continues(run, i, count); i++) {
+                    msg_size = sizes[bench_message_index(run, i, count)];
+                    if (wl.kind != WORKLOAD_FIXED) {
+                        t0 = now_ns();
+                    }
+                    if (stamped) {
+                        sent = now_ns();
+                        memcpy(buf, &sent, sizeof(sent));
+                    }
+                    if (mq_send(mq_down, buf, msg_size, i % priorities) == -1) {
+                        perror("mq_send");
+                        return 1;
+                    }
+                    if (wl.kind != WORKLOAD_FIXED) {
+                        size_histogram_add(&hist, msg_size, now_ns() - t0);
+                    }
+                }
             }
-        }
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-            perror("clock_gettime");
-            return 1;
+            delta = now_ns() - start;
+            if (bench_warmup_done(run, i, delta)) {
+                continue;
+            }
+            if (throughput) {
+                delta /= 1000;
+                run_stats_add(&msg_stats, run, (count * 1000000) / delta);
+                run_stats_add(&thr_stats, run, (bytes * 8) / delta);
+                continue;
+            }
+            run_stats_add(&stats, run, pipeline_latency(&pl, run, delta));
+            run_stats_add(&thr_stats, run, (bytes * 2 * 8 * 1000) / delta);
         }
+        perf_counters_stop();
 
-        delta = ((stop.tv_sec - start.tv_sec) * 1000000000 +
-                 (stop.tv_nsec - start.tv_nsec));
-
-#else
-        if (gettimeofday(&stop, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
+        if (throughput) {
+            run_stats_report(&msg_stats);
+            run_stats_report(&thr_stats);
+        } else {
+            run_stats_report(&stats);
+            pipeline_report(&pl);
+            if (wl.kind != WORKLOAD_FIXED) {
+                run_stats_report(&thr_stats);
+            }
         }
+        if (wl.kind != WORKLOAD_FIXED) {
+            printf("%s by size:\n",
+                   throughput ? "per message send time" : "latency");
+            size_histogram_print(&hist, throughput ? 1 : 2);
+        }
+        perf_counters_report(throughput ? "message" : "roundtrip",
+                             count * bench_opts.runs);
 
-        delta =
-            (stop.tv_sec - start.tv_sec) * 1000000000 + (stop.tv_usec - start.tv_usec) * 1000;
-
-#endif
-
-        printf("average latency: %li ns\n", delta / (count * 2));
+        /* the child has exited, its part of the report is complete */
+        if (method == RECEIVE_TIMED) {
+            printf("expired timed receives: %lli parent, %lli child\n",
+                   (long long)rep->timeouts[0], (long long)rep->timeouts[1]);
+        }
+        if (stamped) {
+            print_delays(rep, priorities);
+        }
         mq_close(mq_up);
         mq_close(mq_down);
         mq_unlink("/UP");
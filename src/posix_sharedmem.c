@@ -30,6 +30,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -39,122 +40,224 @@
 #include <sys/mman.h>
 #include <semaphore.h>
 
+#include "bench.h"
+#include "memory.h"
+#include "payload.h"
+#include "perf.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
 
 #define SHM_NAME "/my_memory"
 #define SHM_SIZE 1024
+#define TEXT_SIZE 256
 
-struct my_memory_region {
-    sem_t writer_sem;
-    sem_t reader_sem;
-    char text[256];
-} *shm;
+/* Where the fields of the control block sit in the region */
+enum layout {
+    LAYOUT_PACKED, /* one after the other, as a plain struct */
+    LAYOUT_PAD64,  /* every field on its own cache line */
+    LAYOUT_PAD128, /* every field on its own pair of lines, which the
+                    * adjacent line prefetcher fetches together */
+    LAYOUT_SPLIT,  /* each message next to the semaphore announcing it,
+                    * the two directions on separate line pairs */
+};
+
+static const char *layout_names[] = {
+    [LAYOUT_PACKED] = "packed",
+    [LAYOUT_PAD64] = "pad64",
+    [LAYOUT_PAD128] = "pad128",
+    [LAYOUT_SPLIT] = "split",
+};
+
+static struct control_block {
+    sem_t *writer_sem; /* posted by the child once the pong is written */
+    sem_t *reader_sem; /* posted by the parent once the ping is written */
+    char *ping;        /* the same text field except with split */
+    char *pong;
+} ctl;
+
+/* Offset of a field of len octets at the first multiple of align */
+static size_t place(size_t *off, size_t len, size_t align)
+{
+    size_t at = (*off + align - 1) & ~(align - 1);
+
+    *off = at + len;
+    return at;
+}
+
+static void layout_apply(enum layout layout, char *base)
+{
+    size_t off = 0, line;
+
+    switch (layout) {
+    case LAYOUT_SPLIT:
+        ctl.reader_sem = (sem_t *)(base + place(&off, sizeof(sem_t), 128));
+        ctl.ping = base + place(&off, TEXT_SIZE, 8);
+        ctl.writer_sem = (sem_t *)(base + place(&off, sizeof(sem_t), 128));
+        ctl.pong = base + place(&off, TEXT_SIZE, 8);
+        break;
+    default:
+        line = layout == LAYOUT_PAD64 ? 64 : layout == LAYOUT_PAD128 ? 128 : 8;
+        ctl.writer_sem = (sem_t *)(base + place(&off, sizeof(sem_t), line));
+        ctl.reader_sem = (sem_t *)(base + place(&off, sizeof(sem_t), line));
+        ctl.ping = ctl.pong = base + place(&off, TEXT_SIZE, line);
+        break;
+    }
+}
 
 int main(int argc, char *argv[])
 {
-    int64_t count, i, delta;
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop;
-#else
-    struct timeval start, stop;
-#endif
-
-    if (argc != 2) {
-        printf("usage: sysv_semaphore <roundtrip-count>\n");
+    int64_t count, i, delta, start, seq = 0;
+    int run;
+    struct run_stats stats;
+    const char *name;
+    enum layout layout = LAYOUT_PACKED;
+    char *region;
+
+    if (payload_parse_options(&argc, argv)) {
+        return 1;
+    }
+    name = bench_take_option(&argc, argv, "layout");
+    if (name != NULL) {
+        for (layout = 0; layout <= LAYOUT_SPLIT; layout++) {
+            if (strcmp(name, layout_names[layout]) == 0) {
+                break;
+            }
+        }
+        if (layout > LAYOUT_SPLIT) {
+            fprintf(stderr, "bad value for --layout: '%s'\n", name);
+        }
+    }
+    if (layout > LAYOUT_SPLIT || bench_parse_options(&argc, argv) ||
+            argc != 2) {
+        printf("usage: posix_sharedmem [options] <roundtrip-count>\n"
+               "  --layout=L       control block layout: packed, pad64,\n"
+               "                   pad128 or split\n"
+               "%s%s",
+               payload_usage(), bench_usage());
         return 1;
     }
 
     count = atol(argv[1]);
 
     printf("roundtrip count: %li\n", (long)count);
+    payload_print();
+    printf("layout: %s\n", layout_names[layout]);
 
     /* Create shared memory */
-    int fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0);
-    if (-1 == fd) {
-        perror("shm_open()");
-        return 1;
-    }
-    if (ftruncate(fd, SHM_SIZE)) {
-        perror("ftruncate()");
-        return 1;
-    }
+    if (bench_opts.pages != PAGES_DEFAULT) {
+        /* shm_open cannot give huge pages */
+        region = memory_alloc_shared(SHM_SIZE);
+        if (region == NULL) {
+            return 1;
+        }
+    } else {
+        int fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0);
+        if (-1 == fd) {
+            perror("shm_open()");
+            return 1;
+        }
+        if (ftruncate(fd, SHM_SIZE)) {
+            perror("ftruncate()");
+            return 1;
+        }
 
-    shm = mmap(NULL, SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (MAP_FAILED == shm) {
-        perror("mmap()");
-        return 1;
+        region = mmap(NULL, SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (MAP_FAILED == region) {
+            perror("mmap()");
+            return 1;
+        }
+        /* File handle, and actual shared memory region
+         * can now be removed, as kernel will then remove it once remaining applications
+         * call munmap() or close all handles to it, or exit.
+         * We still have mmap() handle into the region so it remains effective.
+         */
+        if (close(fd)) {
+            perror("close()");
+            return 1;
+        }
+        if (shm_unlink(SHM_NAME)) {
+            perror("shm_unlink()");
+            return 1;
+        }
     }
-    /* File handle, and actual shared memory region
-     * can now be removed, as kernel will then remove it once remaining applications
-     * call munmap() or close all handles to it, or exit.
-     * We still have mmap() handle into the region so it remains effective.
-     */
-    if (close(fd)) {
-        perror("close()");
+
+    bench_prefault(region, SHM_SIZE);
+    layout_apply(layout, region);
+
+    /* Init process shared semaphores */
+    if (sem_init(ctl.writer_sem, 1, 1) || sem_init(ctl.reader_sem, 1, 0)) {
+        perror("sem_init()");
         return 1;
     }
-    if (shm_unlink(SHM_NAME)) {
-        perror("shm_unlink()");
+
+    if (run_stats_init(&stats, "latency", "ns", bench_opts.runs)) {
         return 1;
     }
 
-    /* Init process shared semaphores */
-    if (sem_init(&shm->writer_sem, 1, 1) || sem_init(&shm->reader_sem, 1, 0)) {
-        perror("sem_init()");
+    if (perf_counters_init(1) || payload_init(TEXT_SIZE)) {
         return 1;
     }
 
     if (!fork()) { /* child */
-        for (i = 0; i < count; i++) {
-            sem_wait(&shm->reader_sem);
-            snprintf(shm->text, 256, "Pong");
-            sem_post(&shm->writer_sem);
+        realtime_enter_peer();
+        perf_counters_open(1);
+        bench_lock(region, SHM_SIZE);
+        for (i = 0; i < bench_peer_iterations(count); i++) {
+            perf_counters_peer_mark(i, count);
+            sem_wait(ctl.reader_sem);
+            /* ping n is message 2n, its pong 2n + 1 */
+            if (payload_verify) {
+                payload_check(ctl.ping, TEXT_SIZE, 2 * i);
+                payload_fill(ctl.pong, TEXT_SIZE, 2 * i + 1);
+            } else {
+                snprintf(ctl.pong, TEXT_SIZE, "Pong");
+            }
+            sem_post(ctl.writer_sem);
         }
+        perf_counters_stop();
 
     } else { /* parent */
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-            perror("clock_gettime");
-            return 1;
-        }
-#else
-        if (gettimeofday(&start, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
-        }
-#endif
-        for (i = 0; i < count; i++) {
-            sem_wait(&shm->writer_sem);
-            snprintf(shm->text, 256, "Ping");
-            sem_post(&shm->reader_sem);
-        }
+        perf_counters_open(0);
+        for (run = bench_first_run(); run < bench_total_runs(); run++) {
+            if (run == bench_opts.warmup_runs) {
+                perf_counters_start();
+            }
+            start = now_ns();
+            for (i = 0; bench_run_continues(run, i, count); i++) {
+                sem_wait(ctl.writer_sem);
+                if (payload_verify) {
+                    if (seq > 0) {
+                        payload_check(ctl.pong, TEXT_SIZE, seq - 1);
+                    }
+                    payload_fill(ctl.ping, TEXT_SIZE, seq);
+                    seq += 2;
+                } else {
+                    snprintf(ctl.ping, TEXT_SIZE, "Ping");
+                }
+                sem_post(ctl.reader_sem);
+            }
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-            perror("clock_gettime");
-            return 1;
+            delta = now_ns() - start;
+            if (bench_warmup_done(run, i, delta)) {
+                continue;
+            }
+            run_stats_add(&stats, run, delta / (count * 2));
         }
-
-        delta = ((stop.tv_sec - start.tv_sec) * 1000000000 +
-                 (stop.tv_nsec - start.tv_nsec));
-
-#else
-        if (gettimeofday(&stop, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
+        perf_counters_stop();
+        if (payload_verify) {
+            /* the last pong */
+            sem_wait(ctl.writer_sem);
+            payload_check(ctl.pong, TEXT_SIZE, seq - 1);
         }
-
-        delta =
-            (stop.tv_sec - start.tv_sec) * 1000000000 + (stop.tv_usec - start.tv_usec) * 1000;
-
-#endif
         wait(NULL);
-        printf("average latency: %lli ns\n", delta / (count * 2));
+        run_stats_report(&stats);
+        perf_counters_report("roundtrip", count * bench_opts.runs);
+        if (payload_report()) {
+            return 1;
+        }
     }
 
     return 0;
@@ -40,11 +40,13 @@
 #include <sys/mman.h>
 #include <semaphore.h>
 
+#include "bench.h"
+#include "memory.h"
+#include "perf.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
 
 #define SHM_NAME "/my_memory"
 
@@ -56,16 +58,14 @@ struct my_memory_region {
 
 int main(int argc, char *argv[])
 {
-    int64_t count, delta;
+    int64_t count, i, delta, start;
     int childrens;
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop;
-#else
-    struct timeval start, stop;
-#endif
-
-    if (argc != 3) {
-        printf("usage: sysv_semaphore <roundtrip-count> <child-count>\n");
+    int run;
+    struct run_stats stats;
+
+    if (bench_parse_options(&argc, argv) || argc != 3) {
+        printf("usage: posix_sharedmem_multi [options] <roundtrip-count> "
+               "<child-count>\n%s", bench_usage());
         return 1;
     }
 
@@ -76,33 +76,51 @@ int main(int argc, char *argv[])
     printf("roundtrip count: %li\n", (long)count);
     printf("Child processes: %i\n", childrens);
 
-    /* Create shared memory */
-    int fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0);
-    if (-1 == fd) {
-        perror("shm_open()");
-        return 1;
-    }
-    if (ftruncate(fd, sizeof (struct my_memory_region) * childrens)) {
-        perror("ftruncate()");
+    if (run_stats_init(&stats, "latency", "ns", bench_opts.runs)) {
         return 1;
     }
 
-    shm = mmap(NULL, sizeof (struct my_memory_region) * childrens, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (MAP_FAILED == shm) {
-        perror("mmap()");
-        return 1;
-    }
-    /* File handle, and actual shared memory region
-     * can now be removed, as kernel will then remove it once remaining applications
-     * call munmap() or close all handles to it, or exit.
-     * We still have mmap() handle into the region so it remains effective.
-     */
-    if (close(fd)) {
-        perror("close()");
-        return 1;
+    /* Create shared memory */
+    if (bench_opts.pages != PAGES_DEFAULT) {
+        /* shm_open cannot give huge pages */
+        shm = memory_alloc_shared(sizeof (struct my_memory_region) * childrens);
+        if (shm == NULL) {
+            return 1;
+        }
+    } else {
+        int fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0);
+        if (-1 == fd) {
+            perror("shm_open()");
+            return 1;
+        }
+        if (ftruncate(fd, sizeof (struct my_memory_region) * childrens)) {
+            perror("ftruncate()");
+            return 1;
+        }
+
+        shm = mmap(NULL, sizeof (struct my_memory_region) * childrens, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (MAP_FAILED == shm) {
+            perror("mmap()");
+            return 1;
+        }
+        /* File handle, and actual shared memory region
+         * can now be removed, as kernel will then remove it once remaining applications
+         * call munmap() or close all handles to it, or exit.
+         * We still have mmap() handle into the region so it remains effective.
+         */
+        if (close(fd)) {
+            perror("close()");
+            return 1;
+        }
+        if (shm_unlink(SHM_NAME)) {
+            perror("shm_unlink()");
+            return 1;
+        }
     }
-    if (shm_unlink(SHM_NAME)) {
-        perror("shm_unlink()");
+
+    bench_prefault(shm, sizeof (struct my_memory_region) * childrens);
+
+    if (perf_counters_init(childrens)) {
         return 1;
     }
 
@@ -114,56 +132,45 @@ int main(int argc, char *argv[])
         }
 
         if (!fork()) { /* child */
-            for (int j = 0; j < count; ++j) {
+            realtime_enter_peer();
+            perf_counters_open(i + 1);
+            bench_lock(shm, sizeof (struct my_memory_region) * childrens);
+            for (int j = 0; j < bench_peer_iterations(count); ++j) {
+                perf_counters_peer_mark(j, count);
                 sem_wait(&shm[i].reader_sem);
                 snprintf(shm[i].text, 256, "Pong");
                 sem_post(&shm[i].writer_sem);
             }
+            perf_counters_stop();
             /* Child exit here */
             return 0;
         }
     }
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-        perror("clock_gettime");
-        return 1;
-    }
-#else
-    if (gettimeofday(&start, NULL) == -1) {
-        perror("gettimeofday");
-        return 1;
-    }
-#endif
-    for (int i = 0; i < count; i++) {
-        for (int j = 0; j < childrens; ++j) {
-            sem_wait(&shm[j].writer_sem);
-            snprintf(shm[j].text, 256, "Ping");
-            sem_post(&shm[j].reader_sem);
+    perf_counters_open(0);
+    for (run = bench_first_run(); run < bench_total_runs(); run++) {
+        if (run == bench_opts.warmup_runs) {
+            perf_counters_start();
+        }
+        start = now_ns();
+        for (i = 0; bench_run_continues(run, i, count); i++) {
+            for (int j = 0; j < childrens; ++j) {
+                sem_wait(&shm[j].writer_sem);
+                snprintf(shm[j].text, 256, "Ping");
+                sem_post(&shm[j].reader_sem);
+            }
         }
-    }
-
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-        perror("clock_gettime");
-        return 1;
-    }
-
-    delta = ((stop.tv_sec - start.tv_sec) * 1000000000 +
-                (stop.tv_nsec - start.tv_nsec));
 
-#else
-    if (gettimeofday(&stop, NULL) == -1) {
-        perror("gettimeofday");
-        return 1;
+        delta = now_ns() - start;
+        if (bench_warmup_done(run, i, delta)) {
+            continue;
+        }
+        run_stats_add(&stats, run, delta / (count * 2));
     }
-
-    delta =
-        (stop.tv_sec - start.tv_sec) * 1000000000 + (stop.tv_usec - start.tv_usec) * 1000;
-
-#endif
+    perf_counters_stop();
     wait(NULL);
-    printf("average latency: %lli ns\n", delta / (count * 2));
+    run_stats_report(&stats);
+    perf_counters_report("roundtrip", count * bench_opts.runs);
 
     return 0;
 }
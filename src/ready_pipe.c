@@ -0,0 +1,82 @@
+/*
+    Startup handshake between a listening child and its parent
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ready_pipe.h"
+
+#include "workload.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+struct ready_message {
+    socklen_t len;
+    struct sockaddr_storage addr;
+};
+
+int ready_pipe_init(struct ready_pipe *r)
+{
+    if (pipe(r->fds) == -1) {
+        perror("pipe");
+        return -1;
+    }
+    return 0;
+}
+
+int ready_pipe_signal(struct ready_pipe *r, int fd)
+{
+    struct ready_message m;
+
+    close(r->fds[0]);
+    m.len = sizeof(m.addr);
+    if (getsockname(fd, (struct sockaddr *)&m.addr, &m.len) == -1) {
+        perror("getsockname");
+        return -1;
+    }
+    if (write_full(r->fds[1], &m, sizeof(m))) {
+        perror("write");
+        return -1;
+    }
+    close(r->fds[1]);
+    return 0;
+}
+
+int ready_pipe_wait(struct ready_pipe *r, struct sockaddr_storage *addr,
+                    socklen_t *len)
+{
+    struct ready_message m;
+
+    close(r->fds[1]);
+    if (read_full(r->fds[0], &m, sizeof(m))) {
+        fprintf(stderr, "peer exited before it was ready\n");
+        return -1;
+    }
+    close(r->fds[0]);
+    *addr = m.addr;
+    *len = m.len;
+    return 0;
+}
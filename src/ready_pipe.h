@@ -0,0 +1,50 @@
+/*
+    Startup handshake between a listening child and its parent
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_READY_PIPE_H
+#define IPC_BENCH_READY_PIPE_H
+
+#include <sys/socket.h>
+
+/* The child binds to an ephemeral port and, once the socket can take
+ * connections or datagrams, writes its address into the pipe. The parent
+ * blocks on the other end instead of sleeping, and concurrent runs never
+ * collide on a fixed port. */
+struct ready_pipe {
+    int fds[2];
+};
+
+/* Before fork */
+int ready_pipe_init(struct ready_pipe *r);
+/* In the child: passes the local address of fd to the parent */
+int ready_pipe_signal(struct ready_pipe *r, int fd);
+/* In the parent: waits for the address, fails if the child exits first */
+int ready_pipe_wait(struct ready_pipe *r, struct sockaddr_storage *addr,
+                    socklen_t *len);
+
+#endif
@@ -0,0 +1,277 @@
+/*
+    Scheduling policy and memory locking of the benchmark processes
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#define _GNU_SOURCE
+
+#include "realtime.h"
+
+#include "bench.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#ifndef SCHED_BATCH
+#define SCHED_BATCH 3
+#endif
+#ifndef SCHED_IDLE
+#define SCHED_IDLE 5
+#endif
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+#ifndef SCHED_FLAG_RESET_ON_FORK
+#define SCHED_FLAG_RESET_ON_FORK 0x01
+#endif
+
+/* The sched_setattr argument, glibc only has a wrapper since 2.41 */
+struct deadline_attr {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime; /* ns */
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+};
+
+static const struct {
+    const char *name;
+    int policy;
+} policies[] = {
+    {"other", SCHED_OTHER},
+    {"batch", SCHED_BATCH},
+    {"idle", SCHED_IDLE},
+    {"fifo", SCHED_FIFO},
+    {"rr", SCHED_RR},
+    {"deadline", SCHED_DEADLINE},
+};
+
+static int policy = -1;      /* -1 leaves the scheduling alone */
+static int priority;         /* real-time priority, or nice value */
+static int has_priority;
+static uint64_t runtime_us, deadline_us, period_us;
+static int lock_all;
+
+/* "RUNTIME[:DEADLINE[:PERIOD]]" in microseconds, deadline and period
+ * default to the one before */
+static int parse_deadline(const char *value)
+{
+    unsigned long long v[3] = {0, 0, 0};
+    const char *p = value;
+    char *end;
+    int n;
+
+    for (n = 0; n < 3; n++) {
+        v[n] = strtoull(p, &end, 10);
+        if (end == p || v[n] == 0) {
+            goto bad;
+        }
+        p = end;
+        if (*p != ':') {
+            break;
+        }
+        p++;
+    }
+    if (*p != '\0' || n == 3) {
+        goto bad;
+    }
+    runtime_us = v[0];
+    deadline_us = v[1] ? v[1] : runtime_us;
+    period_us = v[2] ? v[2] : deadline_us;
+    if (runtime_us > deadline_us || deadline_us > period_us) {
+        goto bad;
+    }
+    return 0;
+
+bad:
+    fprintf(stderr, "bad value for --deadline: '%s'\n", value);
+    return -1;
+}
+
+int realtime_parse_options(int *argc, char *argv[])
+{
+    const char *name = bench_take_option(argc, argv, "sched");
+    const char *deadline = bench_take_option(argc, argv, "deadline");
+    const char *prio = bench_take_option(argc, argv, "priority");
+    char *end;
+
+    lock_all = bench_take_option(argc, argv, "mlockall") != NULL;
+
+    if (name != NULL) {
+        for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+            if (strcmp(name, policies[i].name) == 0) {
+                policy = policies[i].policy;
+            }
+        }
+        if (policy == -1) {
+            fprintf(stderr, "bad value for --sched: '%s'\n", name);
+            return -1;
+        }
+    }
+    if (deadline != NULL) {
+        if (parse_deadline(deadline)) {
+            return -1;
+        }
+        policy = SCHED_DEADLINE;
+    } else if (policy == SCHED_DEADLINE) {
+        fprintf(stderr, "--sched=deadline needs --deadline\n");
+        return -1;
+    }
+    if (prio != NULL) {
+        priority = strtol(prio, &end, 10);
+        if (*prio == '\0' || *end != '\0') {
+            fprintf(stderr, "bad value for --priority: '%s'\n", prio);
+            return -1;
+        }
+        has_priority = 1;
+    }
+#ifndef __linux__
+    if (policy != -1) {
+        fprintf(stderr, "--sched needs Linux\n");
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+#ifdef __linux__
+static int set_deadline(void)
+{
+    struct deadline_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE;
+    /* a deadline task may only fork when its children fall back to
+     * SCHED_OTHER, they set their own reservation afterwards */
+    attr.sched_flags = SCHED_FLAG_RESET_ON_FORK;
+    attr.sched_runtime = runtime_us * 1000;
+    attr.sched_deadline = deadline_us * 1000;
+    attr.sched_period = period_us * 1000;
+    if (syscall(SYS_sched_setattr, 0, &attr, 0)) {
+        perror("sched_setattr");
+        return -1;
+    }
+    return 0;
+}
+
+static int set_policy(void)
+{
+    struct sched_param param;
+
+    if (policy == SCHED_DEADLINE) {
+        return set_deadline();
+    }
+
+    memset(&param, 0, sizeof(param));
+    if (policy == SCHED_FIFO || policy == SCHED_RR) {
+        param.sched_priority = has_priority ? priority
+                               : sched_get_priority_min(policy);
+    } else if (has_priority && setpriority(PRIO_PROCESS, 0, priority)) {
+        perror("setpriority");
+        return -1;
+    }
+    if (sched_setscheduler(0, policy, &param)) {
+        perror("sched_setscheduler");
+        return -1;
+    }
+    return 0;
+}
+#endif
+
+static int apply(void)
+{
+#ifdef __linux__
+    if (policy != -1 && set_policy()) {
+        return -1;
+    }
+#endif
+    if (policy == -1 && has_priority &&
+            setpriority(PRIO_PROCESS, 0, priority)) {
+        perror("setpriority");
+        return -1;
+    }
+    if (lock_all && mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        perror("mlockall");
+        return -1;
+    }
+    return 0;
+}
+
+void realtime_enter_peer(void)
+{
+    if (policy == -1 && !has_priority && !lock_all) {
+        return;
+    }
+    /* the peer goes on with the inherited settings, the diagnostic tells
+     * which ones are missing */
+    apply();
+}
+
+int realtime_apply(void)
+{
+    if (policy == -1 && !has_priority && !lock_all) {
+        return 0;
+    }
+
+    printf("scheduling:");
+    for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        if (policies[i].policy == policy) {
+            printf(" %s", policies[i].name);
+        }
+    }
+    if (policy == SCHED_DEADLINE) {
+        printf(" runtime %llu us, deadline %llu us, period %llu us",
+               (unsigned long long)runtime_us,
+               (unsigned long long)deadline_us,
+               (unsigned long long)period_us);
+    } else if (has_priority) {
+        printf(" %s %d",
+               policy == SCHED_FIFO || policy == SCHED_RR ? "priority"
+                                                          : "nice",
+               priority);
+    }
+    if (lock_all) {
+        printf("%smlockall", policy != -1 || has_priority ? ", " : " ");
+    }
+    printf("\n");
+
+    return apply();
+}
@@ -0,0 +1,42 @@
+/*
+    Scheduling policy and memory locking of the benchmark processes
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_REALTIME_H
+#define IPC_BENCH_REALTIME_H
+
+/* Take --sched, --priority, --deadline and --mlockall out of argv */
+int realtime_parse_options(int *argc, char *argv[]);
+/* Apply them to this process */
+int realtime_apply(void);
+/* Apply them again first thing in a peer process or thread the benchmark
+ * starts: memory locks and SCHED_DEADLINE do not survive a fork, and a
+ * deadline reservation is not inherited by threads either. Helpers such
+ * as the noise workers are left alone. */
+void realtime_enter_peer(void);
+
+#endif
@@ -0,0 +1,219 @@
+/*
+    Measure throughput of handing large frames over in shared memory
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "copy.h"
+#include "memory.h"
+#include "payload.h"
+#include "perf.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
+
+/* Slots start on their own page, after the semaphores */
+#define SLOT_ALIGN 4096
+
+struct shm_ring {
+    sem_t free; /* slots the producer may write */
+    sem_t full; /* slots holding a frame for the consumer */
+};
+
+static char *slot_of(struct shm_ring *ring, size_t slot_size, int64_t n,
+                     int slots)
+{
+    return (char *)ring + SLOT_ALIGN + (n % slots) * slot_size;
+}
+
+/* Read the frame without verification, so it is consumed either way */
+static uint64_t touch(const char *p, size_t len)
+{
+    uint64_t sum = 0, v;
+    size_t off;
+
+    for (off = 0; off + sizeof(v) <= len; off += sizeof(v)) {
+        memcpy(&v, p + off, sizeof(v));
+        sum += v;
+    }
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t size, slot_size;
+    int slots = 2;
+    char *src, *slot;
+    struct shm_ring *ring;
+    int64_t count, i, delta, start, t0, copy_ns, seq = 0;
+    int run;
+    struct run_stats msg_stats, thr_stats, copy_stats;
+    volatile uint64_t sink = 0;
+
+    if (copy_parse_options(&argc, argv) ||
+            payload_parse_options(&argc, argv) ||
+            bench_take_int_option(&argc, argv, "slots", 1, &slots) ||
+            bench_parse_options(&argc, argv) || argc != 3 ||
+            atol(argv[1]) <= 0) {
+        printf("usage: shm_thr [options] <message-size> <message-count>\n"
+               "%s"
+               "  --slots=N        frames the producer may be ahead of the\n"
+               "                   consumer (default 2)\n"
+               "%s%s",
+               copy_usage(), payload_usage(), bench_usage());
+        return 1;
+    }
+
+    size = atol(argv[1]);
+    count = atol(argv[2]);
+    slot_size = (size + SLOT_ALIGN - 1) & ~(size_t)(SLOT_ALIGN - 1);
+
+    printf("message size: %zu octets\n", size);
+    printf("message count: %li\n", count);
+    printf("slots: %i\n", slots);
+    copy_print();
+    payload_print();
+
+    if (run_stats_init(&msg_stats, "throughput", "msg/s", bench_opts.runs) ||
+            run_stats_init(&thr_stats, "throughput", "Mb/s",
+                           bench_opts.runs) ||
+            run_stats_init(&copy_stats, "write time", "ns", bench_opts.runs) ||
+            payload_init(size)) {
+        return 1;
+    }
+
+    ring = memory_alloc_shared(SLOT_ALIGN + slots * slot_size);
+    src = memory_alloc(size);
+    if (ring == NULL || src == NULL) {
+        return 1;
+    }
+    bench_prefault(ring, SLOT_ALIGN + slots * slot_size);
+    /* a frame the producer already has, unless every one is filled */
+    memset(src, 0xa5, size);
+
+    if (sem_init(&ring->free, 1, slots) || sem_init(&ring->full, 1, 0)) {
+        perror("sem_init");
+        return 1;
+    }
+
+    if (perf_counters_init(1)) {
+        return 1;
+    }
+
+    if (!fork()) {
+        /* child */
+        realtime_enter_peer();
+        perf_counters_open(1);
+        bench_lock(ring, SLOT_ALIGN + slots * slot_size);
+        for (i = 0; i < bench_peer_iterations(count); i++) {
+            perf_counters_peer_mark(i, count);
+            if (sem_wait(&ring->full)) {
+                perror("sem_wait");
+                return 1;
+            }
+            slot = slot_of(ring, slot_size, i, slots);
+            if (payload_verify) {
+                payload_check(slot, size, i);
+            } else {
+                sink += touch(slot, size);
+            }
+            if (sem_post(&ring->free)) {
+                perror("sem_post");
+                return 1;
+            }
+        }
+        perf_counters_stop();
+    } else {
+        /* parent */
+        bench_prefault(src, size);
+
+        perf_counters_open(0);
+        for (run = bench_first_run(); run < bench_total_runs(); run++) {
+            if (run == bench_opts.warmup_runs) {
+                perf_counters_start();
+            }
+            copy_ns = 0;
+            start = now_ns();
+
+            for (i = 0; bench_run_continues(run, i, count); i++) {
+                if (sem_wait(&ring->free)) {
+                    perror("sem_wait");
+                    return 1;
+                }
+                slot = slot_of(ring, slot_size, seq, slots);
+                if (copy_kernel->copy != NULL && payload_verify) {
+                    /* the private frame is built outside the copy time */
+                    payload_fill(src, size, seq);
+                }
+                t0 = now_ns();
+                if (copy_kernel->copy == NULL) {
+                    /* build the frame where the consumer reads it */
+                    if (payload_verify) {
+                        payload_fill(slot, size, seq);
+                    } else {
+                        memset(slot, (int)seq, size);
+                    }
+                } else {
+                    copy_kernel->copy(slot, src, size);
+                }
+                copy_ns += now_ns() - t0;
+                seq++;
+                if (sem_post(&ring->full)) {
+                    perror("sem_post");
+                    return 1;
+                }
+            }
+
+            delta = now_ns() - start;
+            if (bench_warmup_done(run, i, delta)) {
+                continue;
+            }
+            run_stats_add(&copy_stats, run, copy_ns / count);
+            delta /= 1000;
+            run_stats_add(&msg_stats, run, (count * 1000000) / delta);
+            run_stats_add(&thr_stats, run, (count * size * 8) / delta);
+        }
+        perf_counters_stop();
+
+        run_stats_report(&msg_stats);
+        run_stats_report(&thr_stats);
+        run_stats_report(&copy_stats);
+        perf_counters_report("message", count * bench_opts.runs);
+        if (payload_report()) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
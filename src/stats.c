@@ -0,0 +1,256 @@
+/*
+    Statistics over repeated benchmark runs
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "stats.h"
+
+#include "bench.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BOOTSTRAP_RESAMPLES 2000
+
+/* Scale factor making the MAD a consistent estimator of the standard
+ * deviation for normally distributed data */
+#define MAD_TO_SIGMA 1.4826
+
+/* Robust coefficient of variation above which runs are flagged */
+#define NOISY_CV 0.05
+
+/* Runs further than this many robust sigmas from the median are outliers */
+#define OUTLIER_SIGMAS 3.0
+
+int run_stats_init(struct run_stats *s, const char *name, const char *unit,
+                   int cap)
+{
+    s->name = name;
+    s->unit = unit;
+    s->n = 0;
+    s->cap = cap;
+    s->values = calloc(cap > 0 ? cap : 1, sizeof(*s->values));
+    if (s->values == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    return 0;
+}
+
+void run_stats_free(struct run_stats *s)
+{
+    free(s->values);
+    s->values = NULL;
+    s->n = 0;
+}
+
+void run_stats_add(struct run_stats *s, int run, double value)
+{
+    if (run < bench_opts.warmup_runs || s->n == s->cap) {
+        return;
+    }
+    s->values[s->n++] = value;
+}
+
+double run_stats_mean(const struct run_stats *s)
+{
+    double sum = 0.0;
+
+    for (int i = 0; i < s->n; i++) {
+        sum += s->values[i];
+    }
+    return s->n ? sum / s->n : 0.0;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Median of v[0..n), sorts v in place */
+static double median(double *v, int n)
+{
+    qsort(v, n, sizeof(*v), compare_double);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2.0;
+}
+
+static int compare_int64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+void percentiles_report(const char *name, int64_t *values, int64_t n,
+                        const char *unit)
+{
+    static const double ranks[] = {0.5, 0.9, 0.99, 0.999};
+
+    if (n == 0) {
+        return;
+    }
+    qsort(values, n, sizeof(*values), compare_int64);
+    printf("%s percentiles:", name);
+    for (size_t r = 0; r < sizeof(ranks) / sizeof(ranks[0]); r++) {
+        printf(" p%g %lli,", ranks[r] * 100,
+               (long long)values[(int64_t)(ranks[r] * (n - 1))]);
+    }
+    printf(" max %lli %s\n", (long long)values[n - 1], unit);
+}
+
+#define HISTOGRAM_BUCKETS 64
+#define HISTOGRAM_WIDTH 40
+
+int stats_bucket(uint64_t v)
+{
+    int b = 0;
+
+    for (; v; v >>= 1) {
+        b++;
+    }
+    return b;
+}
+
+void stats_bucket_range(char *range, size_t len, int b)
+{
+    if (b == 0) {
+        snprintf(range, len, "0");
+    } else {
+        snprintf(range, len, "%llu-%llu", 1ULL << (b - 1),
+                 b < 64 ? (1ULL << b) - 1 : ~0ULL);
+    }
+}
+
+void histogram_report(const char *name, const int64_t *values, int64_t n,
+                      const char *unit)
+{
+    int64_t buckets[HISTOGRAM_BUCKETS] = {0};
+    int lo = HISTOGRAM_BUCKETS, hi = 0;
+
+    if (n == 0) {
+        return;
+    }
+    for (int64_t i = 0; i < n; i++) {
+        int b = stats_bucket(values[i] > 0 ? values[i] : 0);
+
+        buckets[b]++;
+        lo = b < lo ? b : lo;
+        hi = b > hi ? b : hi;
+    }
+
+    printf("%s histogram (%s):\n", name, unit);
+    for (int b = lo; b <= hi; b++) {
+        char range[48];
+        int bar = (int)(buckets[b] * HISTOGRAM_WIDTH / n);
+
+        stats_bucket_range(range, sizeof range, b);
+        printf("%24s %12lli %6.2f%% %.*s\n", range, (long long)buckets[b],
+               buckets[b] * 100.0 / n, bar,
+               "########################################");
+    }
+}
+
+uint64_t stats_random(uint64_t *state)
+{
+    uint64_t x = *state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+void run_stats_report(const struct run_stats *s)
+{
+    double *tmp, *boot, med, mad, cv;
+    uint64_t state = 0x853c49e6748fea9bULL;
+    int outliers = 0;
+
+    printf("average %s: %.0f %s\n", s->name, run_stats_mean(s), s->unit);
+    if (s->n < 2) {
+        return;
+    }
+
+    tmp = malloc(s->n * sizeof(*tmp));
+    boot = malloc(BOOTSTRAP_RESAMPLES * sizeof(*boot));
+    if (tmp == NULL || boot == NULL) {
+        perror("malloc");
+        free(tmp);
+        free(boot);
+        return;
+    }
+
+    memcpy(tmp, s->values, s->n * sizeof(*tmp));
+    med = median(tmp, s->n);
+    for (int i = 0; i < s->n; i++) {
+        tmp[i] = fabs(s->values[i] - med);
+    }
+    mad = median(tmp, s->n);
+
+    for (int b = 0; b < BOOTSTRAP_RESAMPLES; b++) {
+        for (int i = 0; i < s->n; i++) {
+            tmp[i] = s->values[stats_random(&state) % s->n];
+        }
+        boot[b] = median(tmp, s->n);
+    }
+    qsort(boot, BOOTSTRAP_RESAMPLES, sizeof(*boot), compare_double);
+
+    printf("runs: %i measured, %i warmup discarded\n", s->n,
+           bench_opts.warmup_runs);
+    printf("median %s: %.0f %s\n", s->name, med, s->unit);
+    printf("median absolute deviation: %.0f %s\n", mad, s->unit);
+    printf("95%% confidence interval of median: %.0f - %.0f %s\n",
+           boot[(int)(BOOTSTRAP_RESAMPLES * 0.025)],
+           boot[(int)(BOOTSTRAP_RESAMPLES * 0.975) - 1], s->unit);
+
+    cv = med != 0.0 ? MAD_TO_SIGMA * mad / fabs(med) : 0.0;
+    for (int i = 0; i < s->n; i++) {
+        double dev = fabs(s->values[i] - med);
+
+        /* tiny MADs of very stable runs would make any jitter an outlier */
+        if (dev > OUTLIER_SIGMAS * MAD_TO_SIGMA * mad &&
+                dev > NOISY_CV * fabs(med)) {
+            printf("run %i: %.0f %s is an outlier\n",
+                   bench_opts.warmup_runs + i + 1, s->values[i], s->unit);
+            outliers++;
+        }
+    }
+    if (cv > NOISY_CV || outliers) {
+        printf("warning: run-to-run variation %.1f%% with %i outlier(s), "
+               "results are likely disturbed by interference\n",
+               cv * 100.0, outliers);
+    }
+
+    free(tmp);
+    free(boot);
+}
@@ -0,0 +1,76 @@
+/*
+    Statistics over repeated benchmark runs
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef IPC_BENCH_STATS_H
+#define IPC_BENCH_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Per-run results of one metric, e.g. the average latency of each run */
+struct run_stats {
+    const char *name; /* "latency", "throughput", ... */
+    const char *unit; /* "ns", "msg/s", ... */
+    int n;
+    int cap;
+    double *values;
+};
+
+int run_stats_init(struct run_stats *s, const char *name, const char *unit,
+                   int cap);
+void run_stats_free(struct run_stats *s);
+
+/* xorshift64*, cheap and reproducible from the same state: for the
+ * bootstrap here and the message sizes of a workload */
+uint64_t stats_random(uint64_t *state);
+
+/* Record the result of run number run, warmup runs are dropped */
+void run_stats_add(struct run_stats *s, int run, double value);
+double run_stats_mean(const struct run_stats *s);
+
+/* Prints "average <name>: <mean> <unit>" like a single run always did and,
+ * for more than one run, the median, MAD, a bootstrapped 95% confidence
+ * interval of the median and a warning about runs that look disturbed. */
+void run_stats_report(const struct run_stats *s);
+
+/* Sorts values[0..n) in place and prints "<name> percentiles:" with the
+ * 50th, 90th, 99th and 99.9th percentile and the maximum */
+void percentiles_report(const char *name, int64_t *values, int64_t n,
+                        const char *unit);
+
+/* Power-of-two bucket of v: 0 holds 0, bucket n holds [2^(n-1), 2^n) */
+int stats_bucket(uint64_t v);
+/* Prints "<low>-<high>" of bucket b into range, 48 octets hold any */
+void stats_bucket_range(char *range, size_t len, int b);
+
+/* Prints the count and share of values in every power-of-two bucket */
+void histogram_report(const char *name, const int64_t *values, int64_t n,
+                      const char *unit);
+
+#endif
@@ -1,5 +1,5 @@
 /*
-    Measure latency of System V message queue
+    Measure latency and throughput of System V message queues
 
 
     Copyright (c) 2019 Seppo Takalo <seppo.takalo@arm.com>
@@ -30,22 +30,174 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <sys/ipc.h>
 #include <sys/msg.h>
 #include <sys/errno.h>
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
+#include "bench.h"
+#include "memory.h"
+#include "perf.h"
+#include "pipeline.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
+#include "workload.h"
 
 struct msgbuf {
     long mtype;       /* message type, must be > 0 */
     char mtext[1];    /* message data */
 };
 
+enum mode {
+    MODE_LATENCY,    /* roundtrips */
+    MODE_THROUGHPUT, /* one way messages */
+    MODE_SELECT,     /* msgrcv by type behind a backlog of other types */
+};
+
+static int parse_options(int *argc, char *argv[], enum mode *mode,
+                         int *qbytes, int *types, int *backlog)
+{
+    const char *name = bench_take_option(argc, argv, "mode");
+
+    if (name == NULL || strcmp(name, "latency") == 0) {
+        *mode = MODE_LATENCY;
+    } else if (strcmp(name, "throughput") == 0) {
+        *mode = MODE_THROUGHPUT;
+    } else if (strcmp(name, "select") == 0) {
+        *mode = MODE_SELECT;
+    } else {
+        fprintf(stderr, "bad value for --mode: '%s'\n", name);
+        return -1;
+    }
+    return bench_take_int_option(argc, argv, "qbytes", 1, qbytes) ||
+           bench_take_int_option(argc, argv, "types", 1, types) ||
+           bench_take_int_option(argc, argv, "backlog", 1, backlog) ? -1 : 0;
+}
+
+/* Create a queue, with a msg_qbytes limit other than the default */
+static int queue_create(int qbytes)
+{
+    struct msqid_ds ds;
+    int q = msgget(IPC_PRIVATE, 0644 | IPC_CREAT | IPC_EXCL);
+
+    if (q == -1) {
+        perror("msgget");
+        return -1;
+    }
+    if (qbytes == 0) {
+        return q;
+    }
+    /* above kernel.msgmnb this needs CAP_SYS_RESOURCE */
+    if (msgctl(q, IPC_STAT, &ds) == -1) {
+        perror("msgctl IPC_STAT");
+        return -1;
+    }
+    ds.msg_qbytes = qbytes;
+    if (msgctl(q, IPC_SET, &ds) == -1) {
+        perror("msgctl IPC_SET");
+        msgctl(q, IPC_RMID, NULL);
+        return -1;
+    }
+    return q;
+}
+
+/* Nanoseconds per msgrcv of a message of one of types types, msgtyp 0 if
+ * types is 0, and msgsnd putting it back, from a queue that holds backlog
+ * messages of all types interleaved. The wanted message is on average
+ * min(types, backlog) / 2 messages from the head of the queue. */
+static int64_t select_point(struct msgbuf *buf, int size, int64_t count,
+                            int types, int backlog, int qbytes)
+{
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    int64_t i, start, delta;
+    long t;
+    int q = queue_create(qbytes);
+
+    if (q == -1) {
+        return -1;
+    }
+    for (i = 0; i < backlog; i++) {
+        buf->mtype = types ? i % types + 1 : 1;
+        if (msgsnd(q, buf, size, IPC_NOWAIT)) {
+            perror("msgsnd backlog");
+            msgctl(q, IPC_RMID, NULL);
+            return -1;
+        }
+    }
+
+    start = now_ns();
+    for (i = 0; i < count; i++) {
+        t = types ? (long)(stats_random(&state) % types) + 1 : 0;
+        if (msgrcv(q, buf, size, t, 0) < 0) {
+            perror("msgrcv");
+            msgctl(q, IPC_RMID, NULL);
+            return -1;
+        }
+        if (msgsnd(q, buf, size, 0)) {
+            perror("msgsnd");
+            msgctl(q, IPC_RMID, NULL);
+            return -1;
+        }
+    }
+    delta = now_ns() - start;
+
+    msgctl(q, IPC_RMID, NULL);
+    return delta / count;
+}
+
+/* Grid of select_point over powers of four up to types and backlog.
+ * Backlogs that do not fit into msg_qbytes are shown as "-". */
+static int select_stress(struct msgbuf *buf, int size, int64_t count,
+                         int types, int backlog, int qbytes)
+{
+    struct msqid_ds ds;
+    int64_t ns, fits;
+    int q = queue_create(qbytes);
+
+    if (q == -1) {
+        return 1;
+    }
+    if (msgctl(q, IPC_STAT, &ds) == -1) {
+        perror("msgctl IPC_STAT");
+        msgctl(q, IPC_RMID, NULL);
+        return 1;
+    }
+    msgctl(q, IPC_RMID, NULL);
+    /* the kernel also counts every message as at least one octet */
+    fits = (int64_t)ds.msg_qbytes / (size > 0 ? size : 1);
+    printf("queue bytes: %lu, backlog of at most %lli messages\n",
+           (unsigned long)ds.msg_qbytes, (long long)fits);
+
+    printf("msgrcv and msgsnd by type (ns), backlog down, types across:\n");
+    printf("  %8s %8s", "backlog", "any");
+    for (int t = 1; t <= types; t *= 4) {
+        printf(" %8d", t);
+    }
+    printf("\n");
+
+    for (int l = 1; l <= backlog; l *= 4) {
+        printf("  %8d", l);
+        for (int t = 0; t <= types; t = t ? t * 4 : 1) {
+            /* every type needs a message in the queue */
+            if (t > l || l > fits) {
+                printf(" %8s", "-");
+                continue;
+            }
+            ns = select_point(buf, size, count, t, l, qbytes);
+            if (ns < 0) {
+                return 1;
+            }
+            printf(" %8lli", (long long)ns);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     int mq_up;
@@ -53,97 +205,212 @@ int main(int argc, char *argv[])
 
     int size;
     struct msgbuf *buf;
-    int64_t count, i, delta;
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop;
-#else
-    struct timeval start, stop;
-#endif
-
-    if (argc != 3) {
-        printf("usage: %s <message-size> <roundtrip-count>\n", argv[0]);
+    ssize_t len;
+    int64_t count, i, delta, bytes, start, t0 = 0, rtt;
+    struct workload wl;
+    size_t *sizes, msg_size;
+    struct size_histogram hist;
+    int run;
+    struct run_stats stats, msg_stats, thr_stats;
+    struct pipeline pl;
+    int step;
+    enum mode mode;
+    int qbytes = 0, types = 256, backlog = 4096;
+    struct msqid_ds ds;
+
+    if (parse_options(&argc, argv, &mode, &qbytes, &types, &backlog) ||
+            pipeline_parse_options(&argc, argv) ||
+            bench_parse_options(&argc, argv) || argc != 3) {
+        printf("usage: %s [options] <message-size> <count>\n"
+               "  --mode=MODE      latency (roundtrips, default), throughput\n"
+               "                   (one way messages) or select (msgrcv by\n"
+               "                   type behind a backlog, count per point)\n"
+               "  --qbytes=N       set msg_qbytes of the queues\n"
+               "  --types=N        select: up to N message types (default 256)\n"
+               "  --backlog=N      select: up to N queued messages (default 4096)\n"
+               "%s%s%s",
+               argv[0], workload_usage(), pipeline_usage(), bench_usage());
         return 1;
     }
 
-    size = atoi(argv[1]);
+    if (workload_parse(&wl, argv[1])) {
+        return 1;
+    }
+    size = wl.max_size;
     count = atol(argv[2]);
 
-    buf = (struct msgbuf *)malloc(size + sizeof(struct msgbuf));
+    sizes = workload_sizes(&wl, count);
+    if (sizes == NULL) {
+        return 1;
+    }
+    size_histogram_reset(&hist);
+    for (bytes = 0, i = 0; i < count; i++) {
+        bytes += sizes[i];
+    }
+
+    if (mode != MODE_LATENCY && pipeline_window > 1) {
+        fprintf(stderr, "--window needs --mode=latency\n");
+        return 1;
+    }
+
+    if (run_stats_init(&stats, "latency", "ns", bench_opts.runs) ||
+            pipeline_init(&pl, count, wl.kind != WORKLOAD_FIXED) ||
+            run_stats_init(&msg_stats, "throughput", "msg/s",
+                           bench_opts.runs) ||
+            run_stats_init(&thr_stats, "throughput", "Mb/s",
+                           bench_opts.runs)) {
+        return 1;
+    }
+
+    buf = memory_alloc(size + sizeof(struct msgbuf));
     if (buf == NULL) {
-        perror("malloc");
         return 1;
     }
     buf->mtype = 1; // Must be positive integer
 
-    printf("message size: %i octets\n", size);
-    printf("roundtrip count: %li\n", count);
+    workload_print(&wl);
+    if (mode == MODE_SELECT) {
+        printf("receives per point: %li\n", count);
+        return select_stress(buf, size, count, types, backlog, qbytes);
+    }
+    printf("%s count: %li\n", mode == MODE_THROUGHPUT ? "message" : "roundtrip",
+           count);
+    pipeline_print();
 
-    mq_up = msgget(IPC_PRIVATE, 0644 | IPC_CREAT | IPC_EXCL);
-    mq_down = msgget(IPC_PRIVATE, 0644 | IPC_CREAT | IPC_EXCL);
+    mq_up = queue_create(qbytes);
+    if (-1 == mq_up) {
+        return 1;
+    }
+    mq_down = queue_create(qbytes);
+    if (-1 == mq_down) {
+        msgctl(mq_up, IPC_RMID, NULL);
+        return 1;
+    }
+    if (msgctl(mq_down, IPC_STAT, &ds) == 0) {
+        printf("queue bytes: %lu\n", (unsigned long)ds.msg_qbytes);
+        /* with both queues full, parent and child would block each other */
+        if ((int64_t)pipeline_window * size > (int64_t)ds.msg_qbytes) {
+            fprintf(stderr, "a window of %d messages of %d octets does not "
+                            "fit into the queue, raise --qbytes\n",
+                    pipeline_window, size);
+            msgctl(mq_up, IPC_RMID, NULL);
+            msgctl(mq_down, IPC_RMID, NULL);
+            return 1;
+        }
+    }
 
-    if ((-1 == mq_up) || (-1 == mq_down)) {
-        perror("msgget");
+    if (perf_counters_init(1)) {
         return 1;
     }
 
     if (!fork()) { /* child */
-        for (i = 0; i < count; i++) {
-            if (msgrcv(mq_down, buf, size, 0, 0) < 0) {
+        realtime_enter_peer();
+        perf_counters_open(1);
+        bench_prefault(buf, size + sizeof(struct msgbuf));
+        for (i = 0; i < bench_peer_iterations(count); i++) {
+            perf_counters_peer_mark(i, count);
+            if ((len = msgrcv(mq_down, buf, size, 0, 0)) < 0) {
                 perror("msgrcv");
                 return 1;
             }
+            if (mode == MODE_THROUGHPUT) {
+                if (len != (ssize_t)sizes[i % count]) {
+                    fprintf(stderr, "msgrcv: unexpected size %zi\n", len);
+                    return 1;
+                }
+                continue;
+            }
 
-            if (msgsnd(mq_up, buf, size, 0)) {
+            if (msgsnd(mq_up, buf, len, 0)) {
                 perror("msgsnd");
                 return 1;
             }
         }
+        perf_counters_stop();
     } else { /* parent */
+        bench_prefault(buf, size + sizeof(struct msgbuf));
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-            perror("clock_gettime");
-            return 1;
-        }
-#else
-        if (gettimeofday(&start, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
-        }
-#endif
-
-        for (i = 0; i < count; i++) {
-            if (msgsnd(mq_down, buf, size, 0)) {
-                perror("msgsnd");
-                return 1;
+        perf_counters_open(0);
+        for (run = bench_first_run(); run < bench_total_runs(); run++) {
+            if (run == bench_opts.warmup_runs) {
+                size_histogram_reset(&hist);
+                perf_counters_start();
             }
-            if (msgrcv(mq_up, buf, size, 0, 0) < 0) {
-                perror("msgrcv");
-                return 1;
+            start = now_ns();
+
+            if (mode == MODE_THROUGHPUT) {
+                for (i = 0; bench_run_continues(run, i, count); i++) {
+                    msg_size = sizes[bench_message_index(run, i, count)];
+                    if (wl.kind != WORKLOAD_FIXED) {
+                        t0 = now_ns();
+                    }
+                    if (msgsnd(mq_down, buf, msg_size, 0)) {
+                        perror("msgsnd");
+                        return 1;
+                    }
+                    if (wl.kind != WORKLOAD_FIXED) {
+                        size_histogram_add(&hist, msg_size, now_ns() - t0);
+                    }
+                }
+            } else {
+                pipeline_start(&pl);
+                while ((step = pipeline_next(&pl, run)) >= 0) {
+                    if (step) {
+                        pipeline_sent(&pl);
+                        if (msgsnd(mq_down, buf, sizes[(pl.sent - 1) % count],
+                                   0)) {
+                            perror("msgsnd");
+                            return 1;
+                        }
+                        continue;
+                    }
+                    if (msgrcv(mq_up, buf, size, 0, 0) < 0) {
+                        perror("msgrcv");
+                        return 1;
+                    }
+                    rtt = pipeline_received(&pl, run);
+                    if (wl.kind != WORKLOAD_FIXED) {
+                        size_histogram_add(&hist,
+                                           sizes[(pl.received - 1) % count],
+                                           rtt);
+                    }
+                }
+                i = pl.sent;
             }
-        }
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-            perror("clock_gettime");
-            return 1;
+            delta = now_ns() - start;
+            if (bench_warmup_done(run, i, delta)) {
+                continue;
+            }
+            if (mode == MODE_THROUGHPUT) {
+                delta /= 1000;
+                run_stats_add(&msg_stats, run, (count * 1000000) / delta);
+                run_stats_add(&thr_stats, run, (bytes * 8) / delta);
+                continue;
+            }
+            run_stats_add(&stats, run, pipeline_latency(&pl, run, delta));
+            run_stats_add(&thr_stats, run, (bytes * 2 * 8 * 1000) / delta);
         }
+        perf_counters_stop();
 
-        delta = ((stop.tv_sec - start.tv_sec) * 1000000000 +
-                 (stop.tv_nsec - start.tv_nsec));
-
-#else
-        if (gettimeofday(&stop, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
+        if (mode == MODE_THROUGHPUT) {
+            run_stats_report(&msg_stats);
+            run_stats_report(&thr_stats);
+            if (wl.kind != WORKLOAD_FIXED) {
+                printf("per message send time by size:\n");
+                size_histogram_print(&hist, 1);
+            }
+        } else {
+            run_stats_report(&stats);
+            pipeline_report(&pl);
+            if (wl.kind != WORKLOAD_FIXED) {
+                run_stats_report(&thr_stats);
+                printf("latency by size:\n");
+                size_histogram_print(&hist, 2);
+            }
         }
-
-        delta =
-            (stop.tv_sec - start.tv_sec) * 1000000000 + (stop.tv_usec - start.tv_usec) * 1000;
-
-#endif
-
-        printf("average latency: %li ns\n", delta / (count * 2));
+        perf_counters_report(mode == MODE_THROUGHPUT ? "message" : "roundtrip",
+                             count * bench_opts.runs);
         msgctl(mq_up, IPC_RMID, NULL);
         msgctl(mq_down, IPC_RMID, NULL);
     }
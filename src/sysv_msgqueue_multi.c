@@ -37,10 +37,13 @@
 #include <sys/msg.h>
 #include <sys/errno.h>
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
+#include "bench.h"
+#include "memory.h"
+#include "perf.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
+#include "workload.h"
 
 struct msgbuf {
     long mtype;       /* message type, must be > 0, use process ID as a type */
@@ -56,28 +59,48 @@ int main(int argc, char *argv[])
 
     int size;
     struct msgbuf *buf;
-    int64_t count, i, delta;
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop;
-#else
-    struct timeval start, stop;
-#endif
-
-    if (argc != 4) {
-        printf("usage: %s <message-size> <roundtrip-count> <number of childs>\n", argv[0]);
+    ssize_t len;
+    int64_t count, i, delta, bytes, start, t0 = 0;
+    struct workload wl;
+    size_t *sizes;
+    struct size_histogram hist;
+    int run;
+    struct run_stats stats, thr_stats;
+
+    if (bench_parse_options(&argc, argv) || argc != 4) {
+        printf("usage: %s [options] <message-size> <roundtrip-count> "
+               "<number of childs>\n%s%s", argv[0], workload_usage(),
+               bench_usage());
         return 1;
     }
 
-    size = atoi(argv[1]);
+    if (workload_parse(&wl, argv[1])) {
+        return 1;
+    }
+    size = wl.max_size;
     count = atol(argv[2]);
     childrens = atoi(argv[3]);
 
-    buf = (struct msgbuf *)malloc(size + sizeof(struct msgbuf));
+    sizes = workload_sizes(&wl, count);
+    if (sizes == NULL) {
+        return 1;
+    }
+    size_histogram_reset(&hist);
+    for (bytes = 0, i = 0; i < count; i++) {
+        bytes += sizes[i];
+    }
+
+    if (run_stats_init(&stats, "latency", "ns", bench_opts.runs) ||
+            run_stats_init(&thr_stats, "throughput", "Mb/s",
+                           bench_opts.runs)) {
+        return 1;
+    }
+
+    buf = memory_alloc(size + sizeof(struct msgbuf));
     if (buf == NULL) {
-        perror("malloc");
         return 1;
     }
-    printf("message size: %i octets\n", size);
+    workload_print(&wl);
     printf("roundtrip count: %li\n", count);
     printf("Number of childs: %d\n", childrens);
 
@@ -89,77 +112,85 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if (perf_counters_init(childrens)) {
+        return 1;
+    }
+
     long childs[childrens];
     for (int j=0; j < childrens; j++) {
         childs[j] = (long)fork();
         if (!childs[j]) { /* child */
+            realtime_enter_peer();
+            perf_counters_open(j + 1);
             long my_pid = (long)getpid();
-            for (i = 0; i < count; i++) {
-                if (msgrcv(mq_down, buf, size, my_pid, 0) < 0) {
+            bench_prefault(buf, size + sizeof(struct msgbuf));
+            for (i = 0; i < bench_peer_iterations(count); i++) {
+                perf_counters_peer_mark(i, count);
+                if ((len = msgrcv(mq_down, buf, size, my_pid, 0)) < 0) {
                     perror("msgrcv");
                     return 1;
                 }
 
                 buf->mtype = master_pid;
-                if (msgsnd(mq_up, buf, size, 0)) {
+                if (msgsnd(mq_up, buf, len, 0)) {
                     perror("msgsnd");
                     return 1;
                 }
             }
+            perf_counters_stop();
             /* Child exit here */
             return 0;
         }
     }
+    bench_prefault(buf, size + sizeof(struct msgbuf));
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-        perror("clock_gettime");
-        return 1;
-    }
-#else
-    if (gettimeofday(&start, NULL) == -1) {
-        perror("gettimeofday");
-        return 1;
-    }
-#endif
-
-    for (i = 0; i < count; i++) {
-        for (int j = 0; j < childrens; j++) {
-            buf->mtype = childs[j];
-            if (msgsnd(mq_down, buf, size, 0)) {
-                perror("msgsnd");
-                return 1;
-            }
+    perf_counters_open(0);
+    for (run = bench_first_run(); run < bench_total_runs(); run++) {
+        if (run == bench_opts.warmup_runs) {
+            size_histogram_reset(&hist);
+            perf_counters_start();
         }
-        for (int j = 0; j < childrens; j++) {
-            if (msgrcv(mq_up, buf, size, master_pid, 0) < 0) {
-                perror("msgrcv");
-                return 1;
+        start = now_ns();
+
+        for (i = 0; bench_run_continues(run, i, count); i++) {
+            if (wl.kind != WORKLOAD_FIXED) {
+                t0 = now_ns();
+            }
+            for (int j = 0; j < childrens; j++) {
+                buf->mtype = childs[j];
+                if (msgsnd(mq_down, buf, sizes[i % count], 0)) {
+                    perror("msgsnd");
+                    return 1;
+                }
+            }
+            for (int j = 0; j < childrens; j++) {
+                if (msgrcv(mq_up, buf, size, master_pid, 0) < 0) {
+                    perror("msgrcv");
+                    return 1;
+                }
+            }
+            if (wl.kind != WORKLOAD_FIXED) {
+                size_histogram_add(&hist, sizes[i % count], now_ns() - t0);
             }
         }
-    }
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-        perror("clock_gettime");
-        return 1;
+        delta = now_ns() - start;
+        if (bench_warmup_done(run, i, delta)) {
+            continue;
+        }
+        run_stats_add(&stats, run, delta / (count * 2));
+        run_stats_add(&thr_stats, run,
+                      (bytes * childrens * 2 * 8 * 1000) / delta);
     }
+    perf_counters_stop();
 
-    delta = ((stop.tv_sec - start.tv_sec) * 1000000000 +
-                (stop.tv_nsec - start.tv_nsec));
-
-#else
-    if (gettimeofday(&stop, NULL) == -1) {
-        perror("gettimeofday");
-        return 1;
+    run_stats_report(&stats);
+    if (wl.kind != WORKLOAD_FIXED) {
+        run_stats_report(&thr_stats);
+        printf("latency by size:\n");
+        size_histogram_print(&hist, 2);
     }
-
-    delta =
-        (stop.tv_sec - start.tv_sec) * 1000000000 + (stop.tv_usec - start.tv_usec) * 1000;
-
-#endif
-
-    printf("average latency: %li ns\n", delta / (count * 2));
+    perf_counters_report("roundtrip", count * bench_opts.runs);
     wait(NULL);
     msgctl(mq_up, IPC_RMID, NULL);
     msgctl(mq_down, IPC_RMID, NULL);
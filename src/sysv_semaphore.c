@@ -39,10 +39,11 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
+#include "bench.h"
+#include "perf.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
 
 #ifdef __linux__
 union semun {
@@ -57,15 +58,14 @@ union semun {
 int main(int argc, char *argv[])
 {
     int semid;
-    int64_t count, i, delta;
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop;
-#else
-    struct timeval start, stop;
-#endif
-
-    if (argc != 2) {
-        printf("usage: sysv_semaphore <roundtrip-count>\n");
+    int64_t count, i, delta, start;
+    int run;
+    struct run_stats stats;
+
+    bench_no_buffers();
+    if (bench_parse_options(&argc, argv) || argc != 2) {
+        printf("usage: sysv_semaphore [options] <roundtrip-count>\n%s",
+               bench_usage());
         return 1;
     }
 
@@ -88,6 +88,14 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if (run_stats_init(&stats, "latency", "ns", bench_opts.runs)) {
+        return 1;
+    }
+
+    if (perf_counters_init(1)) {
+        return 1;
+    }
+
     if (!fork()) { /* child */
         struct sembuf sop_wait = {
             .sem_num = 0,
@@ -100,7 +108,10 @@ int main(int argc, char *argv[])
             .sem_flg = 0
         };
 
-        for (i = 0; i < count; i++) {
+        realtime_enter_peer();
+        perf_counters_open(1);
+        for (i = 0; i < bench_peer_iterations(count); i++) {
+            perf_counters_peer_mark(i, count);
             if (semop(semid, &sop_release, 1)) {
                 perror("semop");
                 return 1;
@@ -111,19 +122,9 @@ int main(int argc, char *argv[])
                 return 1;
             }
         }
+        perf_counters_stop();
     } else { /* parent */
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-            perror("clock_gettime");
-            return 1;
-        }
-#else
-        if (gettimeofday(&start, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
-        }
-#endif
         struct sembuf sop_wait = {
             .sem_num = 1,
             .sem_op = -1,
@@ -135,44 +136,40 @@ int main(int argc, char *argv[])
             .sem_flg = 0
         };
 
-        for (i = 0; i < count; i++) {
-            if (semop(semid, &sop_wait, 1)) {
-                perror("semop");
-                return 1;
+        perf_counters_open(0);
+        for (run = bench_first_run(); run < bench_total_runs(); run++) {
+            if (run == bench_opts.warmup_runs) {
+                perf_counters_start();
             }
-
-            if (semop(semid, &sop_release, 1)) {
-                perror("semop");
-                return 1;
+            start = now_ns();
+
+            for (i = 0; bench_run_continues(run, i, count); i++) {
+                if (semop(semid, &sop_wait, 1)) {
+                    perror("semop");
+                    return 1;
+                }
+
+                if (semop(semid, &sop_release, 1)) {
+                    perror("semop");
+                    return 1;
+                }
             }
-        }
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-            perror("clock_gettime");
-            return 1;
-        }
-
-        delta = ((stop.tv_sec - start.tv_sec) * 1000000000 +
-                 (stop.tv_nsec - start.tv_nsec));
-
-#else
-        if (gettimeofday(&stop, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
+            delta = now_ns() - start;
+            if (bench_warmup_done(run, i, delta)) {
+                continue;
+            }
+            run_stats_add(&stats, run, delta / (count * 2));
         }
-
-        delta =
-            (stop.tv_sec - start.tv_sec) * 1000000000 + (stop.tv_usec - start.tv_usec) * 1000;
-
-#endif
+        perf_counters_stop();
         int ignore;
         waitpid(-1, &ignore, 0);
         if (semctl(semid, 0, IPC_RMID)) {
             perror("semctl(IPC_RMID)");
             return 1;
         }
-        printf("average latency: %lli ns\n", delta / (count * 2));
+        run_stats_report(&stats);
+        perf_counters_report("roundtrip", count * bench_opts.runs);
     }
 
     return 0;
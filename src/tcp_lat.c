@@ -35,21 +35,27 @@
 #include <time.h>
 #include <unistd.h>
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
+#include "bench.h"
+#include "inet_family.h"
+#include "memory.h"
+#include "netns.h"
+#include "perf.h"
+#include "pipeline.h"
+#include "ready_pipe.h"
+#include "realtime.h"
+#include "stats.h"
+#include "tcp_tuning.h"
+#include "timing.h"
 
 int main(int argc, char *argv[])
 {
     int size;
     char *buf;
-    int64_t count, i, delta;
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop;
-#else
-    struct timeval start, stop;
-#endif
+    int64_t count, i, delta, start;
+    int run;
+    struct run_stats stats;
+    struct pipeline pl;
+    int step;
 
     ssize_t len;
     size_t sofar;
@@ -60,19 +66,28 @@ int main(int argc, char *argv[])
     socklen_t addr_size;
     struct addrinfo hints;
     struct addrinfo *res;
+    struct sockaddr_storage server_addr;
+    socklen_t server_len;
+    struct ready_pipe ready;
     int sockfd, new_fd;
 
-    if (argc != 3) {
-        printf("usage: tcp_lat <message-size> <roundtrip-count>\n");
+    if (tcp_tuning_parse_options(&argc, argv) ||
+            inet_family_parse_options(&argc, argv) ||
+            netns_parse_options(&argc, argv) ||
+            pipeline_parse_options(&argc, argv) ||
+            bench_parse_options(&argc, argv) || argc != 3) {
+        printf("usage: tcp_lat [options] <message-size> <roundtrip-count>\n"
+               "%s%s%s%s%s",
+               tcp_tuning_usage(), inet_family_usage(), netns_usage(),
+               pipeline_usage(), bench_usage());
         return 1;
     }
 
     size = atoi(argv[1]);
     count = atol(argv[2]);
 
-    buf = malloc(size);
+    buf = memory_alloc(size);
     if (buf == NULL) {
-        perror("malloc");
         return 1;
     }
 
@@ -80,15 +95,35 @@ int main(int argc, char *argv[])
     hints.ai_family = AF_UNSPEC; // use IPv4 or IPv6, whichever
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_flags = AI_PASSIVE; // fill in my IP for me
-    if ((ret = getaddrinfo("127.0.0.1", "3491", &hints, &res)) != 0) {
+    inet_family_hints(&hints);
+    if ((ret = getaddrinfo(netns_address(1), "0", &hints, &res)) != 0) {
         fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(ret));
         return 1;
     }
 
     printf("message size: %i octets\n", size);
     printf("roundtrip count: %li\n", count);
+    tcp_tuning_print();
+    inet_family_print();
+    netns_print();
+    pipeline_print();
+
+    if (run_stats_init(&stats, "latency", "ns", bench_opts.runs) ||
+            pipeline_init(&pl, count, 0)) {
+        return 1;
+    }
+
+    if (perf_counters_init(1) || ready_pipe_init(&ready) || netns_init()) {
+        return 1;
+    }
 
     if (!fork()) { /* child */
+        if (netns_enter_child()) {
+            return 1;
+        }
+        realtime_enter_peer();
+        perf_counters_open(1);
+        bench_prefault(buf, size);
 
         if ((sockfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol)) ==
                 -1) {
@@ -101,6 +136,10 @@ int main(int argc, char *argv[])
             return 1;
         }
 
+        if (inet_family_apply(sockfd) || tcp_tuning_apply(sockfd)) {
+            return 1;
+        }
+
         if (bind(sockfd, res->ai_addr, res->ai_addrlen) == -1) {
             perror("bind");
             return 1;
@@ -111,6 +150,10 @@ int main(int argc, char *argv[])
             return 1;
         }
 
+        if (ready_pipe_signal(&ready, sockfd)) {
+            return 1;
+        }
+
         addr_size = sizeof their_addr;
 
         if ((new_fd = accept(sockfd, (struct sockaddr *)&their_addr, &addr_size)) ==
@@ -119,25 +162,35 @@ int main(int argc, char *argv[])
             return 1;
         }
 
-        for (i = 0; i < count; i++) {
+        if (tcp_tuning_apply(new_fd)) {
+            return 1;
+        }
+
+        for (i = 0; i < bench_peer_iterations(count); i++) {
+            perf_counters_peer_mark(i, count);
 
             for (sofar = 0; sofar < size;) {
                 len = read(new_fd, buf, size - sofar);
-                if (len == -1) {
+                if (len <= 0) {
                     perror("read");
                     return 1;
                 }
                 sofar += len;
             }
+            tcp_tuning_rearm(new_fd);
 
             if (write(new_fd, buf, size) != size) {
                 perror("write");
                 return 1;
             }
         }
+        perf_counters_stop();
     } else { /* parent */
+        bench_prefault(buf, size);
 
-        sleep(1);
+        if (netns_setup() || ready_pipe_wait(&ready, &server_addr, &server_len)) {
+            return 1;
+        }
 
         if ((sockfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol)) ==
                 -1) {
@@ -145,61 +198,66 @@ int main(int argc, char *argv[])
             return 1;
         }
 
-        if (connect(sockfd, res->ai_addr, res->ai_addrlen) == -1) {
-            perror("connect");
+        if (inet_family_apply(sockfd) || tcp_tuning_apply(sockfd)) {
             return 1;
         }
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-            perror("clock_gettime");
+        if (connect(sockfd, (struct sockaddr *)&server_addr, server_len) == -1) {
+            perror("connect");
             return 1;
         }
-#else
-        if (gettimeofday(&start, NULL) == -1) {
-            perror("gettimeofday");
+
+        /* requests sit in the parent's send and the child's receive
+         * buffer, responses in the reverse ones; beyond both the two
+         * ends block each other in write */
+        if (pipeline_check_fits(pipeline_socket_holds(sockfd, SO_SNDBUF, size) +
+                                    pipeline_socket_holds(sockfd, SO_RCVBUF,
+                                                          size),
+                                size, "socket buffers")) {
             return 1;
         }
-#endif
-
-        for (i = 0; i < count; i++) {
 
-            if (write(sockfd, buf, size) != size) {
-                perror("write");
-                return 1;
+        perf_counters_open(0);
+        for (run = bench_first_run(); run < bench_total_runs(); run++) {
+            if (run == bench_opts.warmup_runs) {
+                perf_counters_start();
             }
+            pipeline_start(&pl);
+            start = now_ns();
+
+            while ((step = pipeline_next(&pl, run)) >= 0) {
+                if (step) {
+                    pipeline_sent(&pl);
+                    if (write(sockfd, buf, size) != size) {
+                        perror("write");
+                        return 1;
+                    }
+                    continue;
+                }
 
-            for (sofar = 0; sofar < size;) {
-                len = read(sockfd, buf, size - sofar);
-                if (len == -1) {
-                    perror("read");
-                    return 1;
+                for (sofar = 0; sofar < size;) {
+                    len = read(sockfd, buf, size - sofar);
+                    if (len <= 0) {
+                        perror("read");
+                        return 1;
+                    }
+                    sofar += len;
                 }
-                sofar += len;
+                tcp_tuning_rearm(sockfd);
+                pipeline_received(&pl, run);
             }
-        }
-
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-            perror("clock_gettime");
-            return 1;
-        }
-
-        delta = ((stop.tv_sec - start.tv_sec) * 1000000000 +
-                 (stop.tv_nsec - start.tv_nsec));
 
-#else
-        if (gettimeofday(&stop, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
+            delta = now_ns() - start;
+            if (bench_warmup_done(run, pl.sent, delta)) {
+                continue;
+            }
+            run_stats_add(&stats, run, pipeline_latency(&pl, run, delta));
         }
+        perf_counters_stop();
 
-        delta =
-            (stop.tv_sec - start.tv_sec) * 1000000000 + (stop.tv_usec - start.tv_usec) * 1000;
-
-#endif
-
-        printf("average latency: %li ns\n", delta / (count * 2));
+        run_stats_report(&stats);
+        pipeline_report(&pl);
+        perf_counters_report("roundtrip", count * bench_opts.runs);
     }
 
     return 0;
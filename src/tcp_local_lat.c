@@ -26,7 +26,9 @@
     OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <errno.h>
 #include <netdb.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -36,45 +38,226 @@
 #include <time.h>
 #include <unistd.h>
 
-int main(int argc, char *argv[])
+#include "bench.h"
+#include "inet_family.h"
+#include "memory.h"
+#include "perf.h"
+#include "realtime.h"
+#include "tcp_tuning.h"
+#include "workload.h"
+
+/* A UDP server gives up once the client has been quiet this long */
+#define UDP_IDLE_SECONDS 5
+
+static int size;
+static int64_t count;
+
+struct echo {
+    pthread_t thread;
+    int fd;
+    int slot; /* of the counters */
+};
+
+/* Echoes the messages of all runs on one accepted connection */
+static void *echo_stream(void *arg)
+{
+    struct echo *e = arg;
+    int fd = e->fd;
+    char *buf = memory_alloc(size);
+    int64_t i;
+
+    if (buf == NULL) {
+        close(fd);
+        return NULL;
+    }
+    if (e->slot > 0) { /* the main thread is set up already */
+        realtime_enter_peer();
+    }
+    bench_prefault(buf, size);
+
+    perf_counters_open(e->slot);
+    for (i = 0; i < bench_peer_iterations(count); i++) {
+        /* a timed warmup ends unseen on the client, so all of it counts */
+        if (bench_opts.warmup_ns || i >= bench_peer_measured_start(count)) {
+            perf_counters_start();
+        }
+        if (read_full(fd, buf, size)) {
+            /* only the client knows when a timed warmup ends, so the
+             * stream ends when it closes */
+            if (!bench_opts.warmup_ns) {
+                perror("read");
+            }
+            break;
+        }
+        tcp_tuning_rearm(fd);
+
+        if (write_full(fd, buf, size)) {
+            perror("write");
+            break;
+        }
+    }
+
+    perf_counters_stop();
+    close(fd);
+    return NULL;
+}
+
+/* The first connection is echoed on the main thread and counts as the
+ * parent, the others as peers */
+static int serve_tcp(int sockfd, int connections)
 {
-    int size;
-    char *buf;
-    int64_t count, i;
+    struct echo *echoes = calloc(connections, sizeof(*echoes));
+    struct sockaddr_storage their_addr;
+    socklen_t addr_size;
+    int c;
 
+    if (echoes == NULL) {
+        perror("calloc");
+        return 1;
+    }
+    if (perf_counters_init(connections - 1)) {
+        return 1;
+    }
+
+    if (listen(sockfd, connections) == -1) {
+        perror("listen");
+        return 1;
+    }
+
+    for (c = 0; c < connections; c++) {
+        addr_size = sizeof their_addr;
+
+        if ((echoes[c].fd = accept(sockfd, (struct sockaddr *)&their_addr,
+                                   &addr_size)) == -1) {
+            perror("accept");
+            return 1;
+        }
+        if (tcp_tuning_apply(echoes[c].fd)) {
+            return 1;
+        }
+        echoes[c].slot = c;
+
+        if (c > 0 && pthread_create(&echoes[c].thread, NULL, echo_stream,
+                                    &echoes[c])) {
+            fprintf(stderr, "pthread_create failed\n");
+            return 1;
+        }
+    }
+
+    echo_stream(&echoes[0]);
+    for (c = 1; c < connections; c++) {
+        pthread_join(echoes[c].thread, NULL);
+    }
+    perf_counters_report("roundtrip", count * bench_opts.runs);
+    free(echoes);
+    return 0;
+}
+
+/* Echoes every datagram to its sender, the sockets of all connections
+ * share the one bound socket. After a timed warmup the server serves
+ * until it is idle. */
+static int serve_udp(int sockfd, int connections)
+{
+    struct sockaddr_storage their_addr;
+    struct timeval idle = {UDP_IDLE_SECONDS, 0};
+    socklen_t addr_size;
+    char *buf = memory_alloc(size);
+    int64_t i;
     ssize_t len;
-    size_t sofar;
+
+    if (buf == NULL || perf_counters_init(0)) {
+        return 1;
+    }
+    bench_prefault(buf, size);
+
+    perf_counters_open(0);
+    for (i = 0; i / connections < bench_peer_iterations(count); i++) {
+        if (bench_opts.warmup_ns ||
+                i / connections >= bench_peer_measured_start(count)) {
+            perf_counters_start();
+        }
+        addr_size = sizeof their_addr;
+        len = recvfrom(sockfd, buf, size, 0, (struct sockaddr *)&their_addr,
+                       &addr_size);
+        if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            printf("idle for %d s, %li datagrams echoed\n", UDP_IDLE_SECONDS,
+                   (long)i);
+            break;
+        }
+        if (len == -1) {
+            perror("recvfrom");
+            return 1;
+        }
+
+        /* lost datagrams never arrive, so stop once the client is gone */
+        if (i == 0 && setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &idle,
+                                 sizeof(idle)) == -1) {
+            perror("setsockopt SO_RCVTIMEO");
+            return 1;
+        }
+
+        if (sendto(sockfd, buf, len, 0, (struct sockaddr *)&their_addr,
+                   addr_size) != len) {
+            perror("sendto");
+            return 1;
+        }
+    }
+    perf_counters_stop();
+
+    perf_counters_report("roundtrip", count * bench_opts.runs * connections);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int udp, connections = 1;
 
     int yes = 1;
     int ret;
-    struct sockaddr_storage their_addr;
-    socklen_t addr_size;
     struct addrinfo hints;
     struct addrinfo *res;
-    int sockfd, new_fd;
+    int sockfd;
 
-    if (argc != 5) {
-        printf("usage: tcp_local_lat <bind-to> <port> <message-size> "
-               "<roundtrip-count>\n");
+    udp = bench_take_option(&argc, argv, "udp") != NULL;
+    if (bench_take_int_option(&argc, argv, "connections", 1, &connections) ||
+            tcp_tuning_parse_options(&argc, argv) ||
+            inet_family_parse_options(&argc, argv) ||
+            bench_parse_options(&argc, argv) || argc != 5) {
+        printf("usage: tcp_local_lat [options] <bind-to> <port> <message-size> "
+               "<roundtrip-count>\n"
+               "  --udp            echo UDP datagrams instead of a TCP stream\n"
+               "  --connections=N  serve N connections of <roundtrip-count>\n"
+               "                   messages each (default 1)\n"
+               "%s%s%s",
+               tcp_tuning_usage(), inet_family_usage(), bench_usage());
+        return 1;
+    }
+    if (udp && tcp_tuning_given()) {
+        fprintf(stderr, "tcp options do not apply to --udp\n");
         return 1;
     }
+    /* responses go out back to back when the client keeps a window */
+    if (tcp_opts.nodelay < 0) {
+        tcp_opts.nodelay = 1;
+    }
 
     size = atoi(argv[3]);
     count = atol(argv[4]);
 
-    buf = malloc(size);
-    if (buf == NULL) {
-        perror("malloc");
-        return 1;
-    }
-
     printf("message size: %i octets\n", size);
     printf("roundtrip count: %li\n", count);
+    printf("protocol: %s, connections: %d\n", udp ? "udp" : "tcp",
+           connections);
+    if (!udp) {
+        tcp_tuning_print();
+    }
+    inet_family_print();
 
     memset(&hints, 0, sizeof hints);
     hints.ai_family = AF_UNSPEC; // use IPv4 or IPv6, whichever
-    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_socktype = udp ? SOCK_DGRAM : SOCK_STREAM;
     hints.ai_flags = AI_PASSIVE; // fill in my IP for me
+    inet_family_hints(&hints);
     if ((ret = getaddrinfo(argv[1], argv[2], &hints, &res)) != 0) {
         fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(ret));
         return 1;
@@ -91,40 +274,15 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    if (bind(sockfd, res->ai_addr, res->ai_addrlen) == -1) {
-        perror("bind");
+    if (inet_family_apply(sockfd) || (!udp && tcp_tuning_apply(sockfd))) {
         return 1;
     }
 
-    if (listen(sockfd, 1) == -1) {
-        perror("listen");
-        return 1;
-    }
-
-    addr_size = sizeof their_addr;
-
-    if ((new_fd = accept(sockfd, (struct sockaddr *)&their_addr, &addr_size)) ==
-            -1) {
-        perror("accept");
+    if (bind(sockfd, res->ai_addr, res->ai_addrlen) == -1) {
+        perror("bind");
         return 1;
     }
 
-    for (i = 0; i < count; i++) {
-
-        for (sofar = 0; sofar < size;) {
-            len = read(new_fd, buf, size - sofar);
-            if (len == -1) {
-                perror("read");
-                return 1;
-            }
-            sofar += len;
-        }
-
-        if (write(new_fd, buf, size) != size) {
-            perror("write");
-            return 1;
-        }
-    }
-
-    return 0;
+    return udp ? serve_udp(sockfd, connections)
+               : serve_tcp(sockfd, connections);
 }
@@ -25,8 +25,9 @@
     FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
     OTHER DEALINGS IN THE SOFTWARE.
 */
-
+#include <errno.h>
 #include <netdb.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -36,94 +37,490 @@
 #include <time.h>
 #include <unistd.h>
 
-int main(int argc, char *argv[])
-{
-    int size;
+#include "bench.h"
+#include "inet_family.h"
+#include "memory.h"
+#include "perf.h"
+#include "pipeline.h"
+#include "realtime.h"
+#include "stats.h"
+#include "tcp_tuning.h"
+#include "timing.h"
+#include "workload.h"
+
+/* Round trip of a request still in flight, or of one given up on */
+#define IN_FLIGHT -1
+#define LOST -2
+
+static struct {
+    int udp;
+    int connections;
+    int timeout_ms; /* until a UDP request counts as lost */
+    const char *output;
+} cfg = {
+    .connections = 1,
+    .timeout_ms = 1000,
+};
+
+static int size;
+static int64_t count;
+
+/* The connections start every run together */
+static pthread_mutex_t run_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t run_cond = PTHREAD_COND_INITIALIZER;
+static int started_run;
+static int connections_done;
+
+struct connection {
+    pthread_t thread;
+    int slot; /* of the counters */
+    int fd;
     char *buf;
-    int64_t count, i, delta;
-    struct timeval start, stop;
+    int64_t *sent_all; /* send time of every measured request */
+    int64_t *rtt_all;  /* round trip of every measured request, or LOST */
+    int64_t *sent;     /* the slots of the current run */
+    int64_t *rtt;      /* IN_FLIGHT while the request is */
+    int64_t slots;     /* request seq goes to slot seq % slots */
+    int64_t base;      /* sequence number of the run's first datagram */
+    int64_t requests, answered, rtt_sum, lost; /* of the current run */
+    int error;
+};
+
+static int parse_options(int *argc, char *argv[])
+{
+    cfg.udp = bench_take_option(argc, argv, "udp") != NULL;
+    cfg.output = bench_take_option(argc, argv, "output");
+    if (bench_take_int_option(argc, argv, "connections", 1,
+                              &cfg.connections) ||
+            bench_take_int_option(argc, argv, "timeout", 1, &cfg.timeout_ms) ||
+            pipeline_parse_options(argc, argv) ||
+            tcp_tuning_parse_options(argc, argv) ||
+            inet_family_parse_options(argc, argv)) {
+        return -1;
+    }
+    if (cfg.udp && tcp_tuning_given()) {
+        fprintf(stderr, "tcp options do not apply to --udp\n");
+        return -1;
+    }
+    /* requests go out back to back with a window */
+    if (tcp_opts.nodelay < 0) {
+        tcp_opts.nodelay = 1;
+    }
+    if (cfg.output != NULL && cfg.output[0] == '\0') {
+        fprintf(stderr, "--output needs a file name\n");
+        return -1;
+    }
+    return 0;
+}
 
+static int connection_open(struct connection *c, struct addrinfo *local,
+                           struct addrinfo *remote)
+{
+    struct timeval timeout = {cfg.timeout_ms / 1000,
+                              (cfg.timeout_ms % 1000) * 1000};
+    /* the measured runs and behind them the slots of the warmup, which
+     * wraps around but never over the window */
+    int64_t scratch = count > pipeline_window ? count : pipeline_window;
+    int64_t len = count * bench_opts.runs + scratch;
+
+    c->buf = memory_alloc(size);
+    if (c->buf == NULL) {
+        return -1;
+    }
+    c->sent_all = malloc(len * sizeof(*c->sent_all));
+    c->rtt_all = malloc(len * sizeof(*c->rtt_all));
+    if (c->sent_all == NULL || c->rtt_all == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    memset(c->buf, 0, size);
+    bench_prefault(c->buf, size);
+
+    if ((c->fd = socket(local->ai_family, local->ai_socktype,
+                        local->ai_protocol)) == -1) {
+        perror("socket");
+        return -1;
+    }
+
+    if (inet_family_apply(c->fd) || (!cfg.udp && tcp_tuning_apply(c->fd))) {
+        return -1;
+    }
+
+    if (bind(c->fd, local->ai_addr, local->ai_addrlen) == -1) {
+        perror("bind");
+        return -1;
+    }
+
+    /* a connected UDP socket only receives from the server */
+    if (connect(c->fd, remote->ai_addr, remote->ai_addrlen) == -1) {
+        perror("connect");
+        return -1;
+    }
+
+    /* requests sit in this send and the server's receive buffer,
+     * responses in the reverse ones, which are taken to be as large;
+     * beyond both the two ends block each other in write */
+    if (!cfg.udp &&
+            pipeline_check_fits(pipeline_socket_holds(c->fd, SO_SNDBUF, size) +
+                                    pipeline_socket_holds(c->fd, SO_RCVBUF,
+                                                          size),
+                                size, "socket buffers")) {
+        return -1;
+    }
+
+    if (cfg.udp && setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                              sizeof(timeout)) == -1) {
+        perror("setsockopt SO_RCVTIMEO");
+        return -1;
+    }
+    return 0;
+}
+
+static int send_request(struct connection *c, int64_t seq)
+{
+    int64_t wire = c->base + seq;
+
+    /* datagrams carry their sequence number, a stream keeps the order */
+    if (cfg.udp) {
+        memcpy(c->buf, &wire, sizeof(wire));
+    }
+    c->rtt[seq % c->slots] = IN_FLIGHT;
+    c->sent[seq % c->slots] = now_ns();
+    if (cfg.udp ? send(c->fd, c->buf, size, 0) != size
+                : write_full(c->fd, c->buf, size) != 0) {
+        perror("send");
+        return -1;
+    }
+    return 0;
+}
+
+/* Takes the next response and its sequence number within the run,
+ * returns 1 on a UDP timeout and -1 on error */
+static int receive_response(struct connection *c, int64_t *next_in_order,
+                            int64_t *seq)
+{
     ssize_t len;
-    size_t sofar;
+
+    if (!cfg.udp) {
+        if (read_full(c->fd, c->buf, size)) {
+            perror("read");
+            return -1;
+        }
+        tcp_tuning_rearm(c->fd);
+        *seq = (*next_in_order)++;
+        return 0;
+    }
+
+    len = recv(c->fd, c->buf, size, 0);
+    if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 1;
+    }
+    if (len != size) {
+        perror("recv");
+        return -1;
+    }
+    memcpy(seq, c->buf, sizeof(*seq));
+    *seq -= c->base;
+    return 0;
+}
+
+/* Keeps up to a window of requests in flight until the run is complete
+ * and all of them are answered or, for UDP, given up on. Datagrams may
+ * come back out of order or not at all, so unlike the pipeline of the
+ * local benchmarks every request is tracked by its sequence number. */
+static int connection_run(struct connection *c, int run)
+{
+    int64_t next = 0, oldest = 0, in_order = 0, seq, s;
+    int ret;
+
+    if (run >= bench_opts.warmup_runs) {
+        c->sent = c->sent_all + (run - bench_opts.warmup_runs) * count;
+        c->rtt = c->rtt_all + (run - bench_opts.warmup_runs) * count;
+        c->slots = count;
+    } else {
+        c->sent = c->sent_all + count * bench_opts.runs;
+        c->rtt = c->rtt_all + count * bench_opts.runs;
+        c->slots = count > pipeline_window ? count : pipeline_window;
+    }
+    c->answered = c->rtt_sum = c->lost = 0;
+
+    for (;;) {
+        while (next - oldest < pipeline_window &&
+                bench_run_continues(run, next, count)) {
+            if (send_request(c, next++)) {
+                return -1;
+            }
+        }
+        if (oldest == next) {
+            break;
+        }
+
+        ret = receive_response(c, &in_order, &seq);
+        if (ret < 0) {
+            return -1;
+        }
+        if (ret > 0) {
+            /* nothing came back within the timeout, write off the window */
+            for (s = oldest; s < next; s++) {
+                if (c->rtt[s % c->slots] == IN_FLIGHT) {
+                    c->rtt[s % c->slots] = LOST;
+                    c->lost++;
+                }
+            }
+        } else if (seq >= oldest && seq < next &&
+                   c->rtt[seq % c->slots] == IN_FLIGHT) {
+            c->rtt[seq % c->slots] = now_ns() - c->sent[seq % c->slots];
+            c->rtt_sum += c->rtt[seq % c->slots];
+            c->answered++;
+        } else {
+            continue; /* late answer to a request already written off */
+        }
+
+        while (oldest < next && c->rtt[oldest % c->slots] != IN_FLIGHT) {
+            oldest++;
+        }
+    }
+    c->requests = next;
+    c->base += next;
+    return 0;
+}
+
+/* Connections beyond the first, which runs on the main thread */
+static void *connection_main(void *arg)
+{
+    struct connection *c = arg;
+
+    realtime_enter_peer();
+    perf_counters_open(c->slot);
+    for (int run = bench_first_run(); run < bench_total_runs(); run++) {
+        pthread_mutex_lock(&run_lock);
+        while (started_run < run) {
+            pthread_cond_wait(&run_cond, &run_lock);
+        }
+        pthread_mutex_unlock(&run_lock);
+        if (run == bench_opts.warmup_runs) {
+            perf_counters_start();
+        }
+
+        if (connection_run(c, run)) {
+            c->error = 1;
+        }
+
+        pthread_mutex_lock(&run_lock);
+        connections_done++;
+        pthread_cond_broadcast(&run_cond);
+        pthread_mutex_unlock(&run_lock);
+        if (c->error) {
+            break;
+        }
+    }
+    perf_counters_stop();
+    return NULL;
+}
+
+/* One line per measured request: run, connection, sequence number, send
+ * time relative to the start of the first measured run and round trip,
+ * or "lost" */
+static int write_output(const char *path, struct connection *conns,
+                        int64_t start)
+{
+    FILE *f = fopen(path, "w");
+    int64_t i, at;
+    int c, run;
+
+    if (f == NULL) {
+        perror("fopen");
+        return -1;
+    }
+    fprintf(f, "run,connection,sequence,send_ns,rtt_ns\n");
+    for (run = 0; run < bench_opts.runs; run++) {
+        for (c = 0; c < cfg.connections; c++) {
+            for (i = 0; i < count; i++) {
+                at = run * count + i;
+                fprintf(f, "%d,%d,%li,%li,", run, c, (long)i,
+                        (long)(conns[c].sent_all[at] - start));
+                if (conns[c].rtt_all[at] >= 0) {
+                    fprintf(f, "%li\n", (long)conns[c].rtt_all[at]);
+                } else {
+                    fprintf(f, "lost\n");
+                }
+            }
+        }
+    }
+    if (fclose(f)) {
+        perror("fclose");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct connection *conns;
+    struct run_stats lat_stats, rate_stats;
+    int64_t *rtts, answered, requests, rtt_sum, rtt_count = 0, lost = 0;
+    int64_t i, start, measured_start = 0, delta;
+    int c, run;
 
     int ret;
     struct addrinfo hints;
-    struct addrinfo *res;
-    int sockfd;
+    struct addrinfo *local, *remote;
 
-    if (argc != 6) {
-        printf("usage: tcp_lat <bind-to> <host> <port> <message-size> "
-               "<roundtrip-count>\n");
+    if (parse_options(&argc, argv) || bench_parse_options(&argc, argv) ||
+            argc != 6) {
+        printf("usage: tcp_remote_lat [options] <bind-to> <host> <port> "
+               "<message-size> <roundtrip-count>\n"
+               "  --udp            send UDP datagrams instead of a TCP stream\n"
+               "  --connections=N  N connections of <roundtrip-count>\n"
+               "                   requests each, one thread each (default 1)\n"
+               "  --timeout=MS     UDP requests unanswered for MS are lost\n"
+               "                   (default 1000)\n"
+               "  --output=FILE    write every request's send time and round\n"
+               "                   trip as csv\n"
+               "%s%s%s%s",
+               pipeline_usage(), tcp_tuning_usage(), inet_family_usage(),
+               bench_usage());
         return 1;
     }
 
     size = atoi(argv[4]);
     count = atol(argv[5]);
 
-    buf = malloc(size);
-    if (buf == NULL) {
-        perror("malloc");
+    if (cfg.udp && size < (int)sizeof(int64_t)) {
+        fprintf(stderr, "--udp needs a message size of at least %zu\n",
+                sizeof(int64_t));
         return 1;
     }
 
     printf("message size: %i octets\n", size);
     printf("roundtrip count: %li\n", count);
+    printf("protocol: %s, connections: %d\n", cfg.udp ? "udp" : "tcp",
+           cfg.connections);
+    pipeline_print();
+    if (!cfg.udp) {
+        tcp_tuning_print();
+    }
+    inet_family_print();
 
     memset(&hints, 0, sizeof hints);
     hints.ai_family = AF_UNSPEC; // use IPv4 or IPv6, whichever
-    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_socktype = cfg.udp ? SOCK_DGRAM : SOCK_STREAM;
     hints.ai_flags = AI_PASSIVE; // fill in my IP for me
-    if ((ret = getaddrinfo(argv[1], NULL, &hints, &res)) != 0) {
+    inet_family_hints(&hints);
+    if ((ret = getaddrinfo(argv[1], NULL, &hints, &local)) != 0) {
         fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(ret));
         return 1;
     }
 
-    if ((sockfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol)) ==
-            -1) {
-        perror("socket");
+    if ((ret = getaddrinfo(argv[2], argv[3], &hints, &remote)) != 0) {
+        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(ret));
         return 1;
     }
 
-    if (bind(sockfd, res->ai_addr, res->ai_addrlen) == -1) {
-        perror("bind");
+    if (run_stats_init(&lat_stats, "latency", "ns", bench_opts.runs) ||
+            run_stats_init(&rate_stats, "rate", "roundtrips/s",
+                           bench_opts.runs)) {
         return 1;
     }
-
-    if ((ret = getaddrinfo(argv[2], argv[3], &hints, &res)) != 0) {
-        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(ret));
+    conns = calloc(cfg.connections, sizeof(*conns));
+    rtts = malloc(count * bench_opts.runs * cfg.connections * sizeof(*rtts));
+    if (conns == NULL || rtts == NULL) {
+        perror("malloc");
         return 1;
     }
+    for (c = 0; c < cfg.connections; c++) {
+        conns[c].slot = c;
+        if (connection_open(&conns[c], local, remote)) {
+            return 1;
+        }
+    }
 
-    if (connect(sockfd, res->ai_addr, res->ai_addrlen) == -1) {
-        perror("connect");
+    /* the first connection counts as the parent, the others as peers */
+    if (perf_counters_init(cfg.connections - 1)) {
         return 1;
     }
 
-    gettimeofday(&start, NULL);
+    /* created up front, so the runs do not time thread creation */
+    started_run = bench_first_run() - 1;
+    for (c = 1; c < cfg.connections; c++) {
+        if (pthread_create(&conns[c].thread, NULL, connection_main,
+                           &conns[c])) {
+            fprintf(stderr, "pthread_create failed\n");
+            return 1;
+        }
+    }
 
-    for (i = 0; i < count; i++) {
+    perf_counters_open(0);
+    for (run = bench_first_run(); run < bench_total_runs(); run++) {
+        if (run == bench_opts.warmup_runs) {
+            perf_counters_start();
+        }
+        pthread_mutex_lock(&run_lock);
+        connections_done = 0;
+        started_run = run;
+        start = now_ns();
+        pthread_cond_broadcast(&run_cond);
+        pthread_mutex_unlock(&run_lock);
 
-        if (write(sockfd, buf, size) != size) {
-            perror("write");
+        if (connection_run(&conns[0], run)) {
             return 1;
         }
+        pthread_mutex_lock(&run_lock);
+        while (connections_done < cfg.connections - 1) {
+            pthread_cond_wait(&run_cond, &run_lock);
+        }
+        pthread_mutex_unlock(&run_lock);
+        delta = now_ns() - start;
 
-        for (sofar = 0; sofar < size;) {
-            len = read(sockfd, buf, size - sofar);
-            if (len == -1) {
-                perror("read");
+        answered = requests = rtt_sum = 0;
+        for (c = 0; c < cfg.connections; c++) {
+            if (conns[c].error) {
                 return 1;
             }
-            sofar += len;
+            answered += conns[c].answered;
+            requests += conns[c].requests;
+            rtt_sum += conns[c].rtt_sum;
+        }
+        if (bench_warmup_done(run, requests, delta) ||
+                run < bench_opts.warmup_runs) {
+            continue;
+        }
+        if (run == bench_opts.warmup_runs) {
+            measured_start = start;
         }
-    }
 
-    gettimeofday(&stop, NULL);
+        for (c = 0; c < cfg.connections; c++) {
+            for (i = 0; i < count; i++) {
+                if (conns[c].rtt[i] >= 0) {
+                    rtts[rtt_count++] = conns[c].rtt[i];
+                }
+            }
+            lost += conns[c].lost;
+        }
+        if (answered > 0) {
+            run_stats_add(&lat_stats, run, rtt_sum / (answered * 2.0));
+        }
+        run_stats_add(&rate_stats, run, answered * 1000000000.0 / delta);
+    }
+    perf_counters_stop();
+    for (c = 1; c < cfg.connections; c++) {
+        pthread_join(conns[c].thread, NULL);
+    }
 
-    delta =
-        (stop.tv_sec - start.tv_sec) * 1000000000 + (stop.tv_usec - start.tv_usec) * 1000;
+    run_stats_report(&lat_stats);
+    run_stats_report(&rate_stats);
+    if (cfg.udp) {
+        printf("lost: %li of %li\n", (long)lost,
+               (long)(count * bench_opts.runs * cfg.connections));
+    }
+    percentiles_report("round trip", rtts, rtt_count, "ns");
+    histogram_report("round trip", rtts, rtt_count, "ns");
+    perf_counters_report("roundtrip", count * bench_opts.runs);
 
-    printf("average latency: %li ns\n", delta / (count * 2));
+    if (cfg.output != NULL &&
+            write_output(cfg.output, conns, measured_start)) {
+        return 1;
+    }
 
     return 0;
 }
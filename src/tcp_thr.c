@@ -36,21 +36,29 @@
 #include <time.h>
 #include <unistd.h>
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
+#include "bench.h"
+#include "inet_family.h"
+#include "netns.h"
+#include "memory.h"
+#include "payload.h"
+#include "perf.h"
+#include "ready_pipe.h"
+#include "realtime.h"
+#include "stats.h"
+#include "tcp_tuning.h"
+#include "timing.h"
+#include "workload.h"
 
 int main(int argc, char *argv[])
 {
     int size;
     char *buf;
-    int64_t count, i, delta;
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop;
-#else
-    struct timeval start, stop;
-#endif
+    int64_t count, i, delta, bytes, start, t0, seq = 0;
+    struct workload wl;
+    size_t *sizes, msg_size;
+    struct size_histogram hist;
+    int run;
+    struct run_stats msg_stats, thr_stats;
 
     ssize_t len;
     size_t sofar;
@@ -61,19 +69,46 @@ int main(int argc, char *argv[])
     socklen_t addr_size;
     struct addrinfo hints;
     struct addrinfo *res;
+    struct sockaddr_storage server_addr;
+    socklen_t server_len;
+    struct ready_pipe ready;
     int sockfd, new_fd;
 
-    if (argc != 3) {
-        printf("usage: tcp_thr <message-size> <message-count>\n");
+    if (tcp_tuning_parse_options(&argc, argv) ||
+            inet_family_parse_options(&argc, argv) ||
+            netns_parse_options(&argc, argv) ||
+            payload_parse_options(&argc, argv) ||
+            bench_parse_options(&argc, argv) || argc != 3) {
+        printf("usage: tcp_thr [options] <message-size> <message-count>\n"
+               "%s%s%s%s%s%s",
+               workload_usage(), tcp_tuning_usage(), inet_family_usage(),
+               netns_usage(), payload_usage(), bench_usage());
         return 1;
     }
 
-    size = atoi(argv[1]);
+    if (workload_parse(&wl, argv[1])) {
+        return 1;
+    }
+    size = wl.max_size;
     count = atol(argv[2]);
 
-    buf = malloc(size);
+    sizes = workload_sizes(&wl, count);
+    if (sizes == NULL) {
+        return 1;
+    }
+    size_histogram_reset(&hist);
+    for (bytes = 0, i = 0; i < count; i++) {
+        bytes += sizes[i];
+    }
+
+    if (run_stats_init(&msg_stats, "throughput", "msg/s", bench_opts.runs) ||
+            run_stats_init(&thr_stats, "throughput", "Mb/s",
+                           bench_opts.runs)) {
+        return 1;
+    }
+
+    buf = memory_alloc(sizeof(frame_header_t) + size);
     if (buf == NULL) {
-        perror("malloc");
         return 1;
     }
 
@@ -81,16 +116,32 @@ int main(int argc, char *argv[])
     hints.ai_family = AF_UNSPEC; // use IPv4 or IPv6, whichever
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_flags = AI_PASSIVE; // fill in my IP for me
-    if ((ret = getaddrinfo("127.0.0.1", "3491", &hints, &res)) != 0) {
+    inet_family_hints(&hints);
+    if ((ret = getaddrinfo(netns_address(1), "0", &hints, &res)) != 0) {
         fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(ret));
         return 1;
     }
 
-    printf("message size: %i octets\n", size);
+    workload_print(&wl);
     printf("message count: %li\n", count);
+    tcp_tuning_print();
+    inet_family_print();
+    netns_print();
+    payload_print();
+
+    if (perf_counters_init(1) || ready_pipe_init(&ready) || netns_init() ||
+            payload_init(wl.min_size)) {
+        return 1;
+    }
 
     if (!fork()) {
         /* child */
+        if (netns_enter_child()) {
+            return 1;
+        }
+        realtime_enter_peer();
+        perf_counters_open(1);
+        bench_prefault(buf, sizeof(frame_header_t) + size);
 
         if ((sockfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol)) ==
                 -1) {
@@ -103,6 +154,10 @@ int main(int argc, char *argv[])
             return 1;
         }
 
+        if (inet_family_apply(sockfd) || tcp_tuning_apply(sockfd)) {
+            return 1;
+        }
+
         if (bind(sockfd, res->ai_addr, res->ai_addrlen) == -1) {
             perror("bind");
             return 1;
@@ -113,6 +168,10 @@ int main(int argc, char *argv[])
             return 1;
         }
 
+        if (ready_pipe_signal(&ready, sockfd)) {
+            return 1;
+        }
+
         addr_size = sizeof their_addr;
 
         if ((new_fd = accept(sockfd, (struct sockaddr *)&their_addr, &addr_size)) ==
@@ -121,18 +180,57 @@ int main(int argc, char *argv[])
             return 1;
         }
 
-        for (sofar = 0; sofar < (count * size);) {
-            len = read(new_fd, buf, size);
-            if (len == -1) {
-                perror("read");
-                return 1;
+        if (tcp_tuning_apply(new_fd)) {
+            return 1;
+        }
+
+        if (wl.kind == WORKLOAD_FIXED && payload_verify) {
+            /* checking needs whole messages rather than arbitrary chunks */
+            for (i = 0; i < bench_peer_iterations(count); i++) {
+                perf_counters_peer_mark(i, count);
+                if (read_full(new_fd, buf, size)) {
+                    perror("read");
+                    return 1;
+                }
+                tcp_tuning_rearm(new_fd);
+                payload_check(buf, size, i);
+            }
+            perf_counters_stop();
+        } else if (wl.kind == WORKLOAD_FIXED) {
+            for (sofar = 0; (int64_t)(sofar / size) < bench_peer_iterations(count);) {
+                perf_counters_peer_mark(sofar / size, count);
+                len = read(new_fd, buf, size);
+                if (len == -1) {
+                    perror("read");
+                    return 1;
+                }
+                sofar += len;
+                tcp_tuning_rearm(new_fd);
             }
-            sofar += len;
+            perf_counters_stop();
+        } else {
+            for (i = 0; i < bench_peer_iterations(count); i++) {
+                perf_counters_peer_mark(i, count);
+                if (read_frame(new_fd, buf, size) !=
+                        (ssize_t)sizes[i % count]) {
+                    perror("read_frame");
+                    return 1;
+                }
+                tcp_tuning_rearm(new_fd);
+                if (payload_verify) {
+                    payload_check(buf + sizeof(frame_header_t), sizes[i % count],
+                                  i);
+                }
+            }
+            perf_counters_stop();
         }
     } else {
         /* parent */
+        bench_prefault(buf, sizeof(frame_header_t) + size);
 
-        sleep(1);
+        if (netns_setup() || ready_pipe_wait(&ready, &server_addr, &server_len)) {
+            return 1;
+        }
 
         if ((sockfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol)) ==
                 -1) {
@@ -140,58 +238,76 @@ int main(int argc, char *argv[])
             return 1;
         }
 
-        if (connect(sockfd, res->ai_addr, res->ai_addrlen) == -1) {
-            perror("connect");
+        if (inet_family_apply(sockfd) || tcp_tuning_apply(sockfd)) {
             return 1;
         }
 
-        if (setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(int)) == -1) {
-            perror("setsockopt");
+        if (connect(sockfd, (struct sockaddr *)&server_addr, server_len) == -1) {
+            perror("connect");
             return 1;
         }
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-            perror("clock_gettime");
-            return 1;
-        }
-#else
-        if (gettimeofday(&start, NULL) == -1) {
-            perror("gettimeofday");
+        /* the sender has always run without Nagle unless told otherwise */
+        if (tcp_opts.nodelay < 0 &&
+                setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(int)) == -1) {
+            perror("setsockopt");
             return 1;
         }
-#endif
 
-        for (i = 0; i < count; i++) {
-            if (write(sockfd, buf, size) != size) {
-                perror("write");
-                return 1;
+        perf_counters_open(0);
+        for (run = bench_first_run(); run < bench_total_runs(); run++) {
+            if (run == bench_opts.warmup_runs) {
+                size_histogram_reset(&hist);
+                perf_counters_start();
+            }
+            start = now_ns();
+
+            if (wl.kind == WORKLOAD_FIXED) {
+                for (i = 0; bench_run_continues(run, i, count); i++) {
+                    if (payload_verify) {
+                        payload_fill(buf, size, seq++);
+                    }
+                    if (write(sockfd, buf, size) != size) {
+                        perror("write");
+                        return 1;
+                    }
+                }
+            } else {
+                for (i = 0; bench_run_continues(run, i, count); i++) {
+                    msg_size = sizes[bench_message_index(run, i, count)];
+                    if (payload_verify) {
+                        payload_fill(buf + sizeof(frame_header_t), msg_size,
+                                     seq++);
+                    }
+                    t0 = now_ns();
+                    if (write_frame(sockfd, buf, msg_size)) {
+                        perror("write_frame");
+                        return 1;
+                    }
+                    size_histogram_add(&hist, msg_size, now_ns() - t0);
+                }
             }
-        }
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-            perror("clock_gettime");
-            return 1;
+            delta = now_ns() - start;
+            if (bench_warmup_done(run, i, delta)) {
+                continue;
+            }
+            delta /= 1000;
+            run_stats_add(&msg_stats, run, (count * 1000000) / delta);
+            run_stats_add(&thr_stats, run, (bytes * 8) / delta);
         }
+        perf_counters_stop();
 
-        delta = ((stop.tv_sec - start.tv_sec) * 1000000 +
-                 (stop.tv_nsec - start.tv_nsec) / 1000);
-
-#else
-        if (gettimeofday(&stop, NULL) == -1) {
-            perror("gettimeofday");
+        run_stats_report(&msg_stats);
+        run_stats_report(&thr_stats);
+        if (wl.kind != WORKLOAD_FIXED) {
+            printf("per message send time by size:\n");
+            size_histogram_print(&hist, 1);
+        }
+        perf_counters_report("message", count * bench_opts.runs);
+        if (payload_report()) {
             return 1;
         }
-
-        delta =
-            (stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
-
-#endif
-
-        printf("average throughput: %li msg/s\n", (count * 1000000) / delta);
-        printf("average throughput: %li Mb/s\n",
-               (((count * 1000000) / delta) * size * 8) / 1000000);
     }
 
     return 0;
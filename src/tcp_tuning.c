@@ -0,0 +1,183 @@
+/*
+    TCP socket options shared by the TCP benchmarks
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "tcp_tuning.h"
+
+#include "bench.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+struct tcp_tuning tcp_opts = {
+    .nodelay = -1,
+    .cork = -1,
+    .quickack = -1,
+    .busy_poll = -1,
+    .sndbuf = -1,
+    .rcvbuf = -1,
+    .notsent_lowat = -1,
+    .priority = -1,
+};
+
+static const struct {
+    const char *name;
+    int level, option;
+    size_t offset;
+    int flag; /* 0 or 1, a bare --name is 1 */
+} options[] = {
+#ifdef TCP_NODELAY
+    {"nodelay", IPPROTO_TCP, TCP_NODELAY,
+     offsetof(struct tcp_tuning, nodelay), 1},
+#endif
+#ifdef TCP_CORK
+    {"cork", IPPROTO_TCP, TCP_CORK, offsetof(struct tcp_tuning, cork), 1},
+#endif
+#ifdef TCP_QUICKACK
+    {"quickack", IPPROTO_TCP, TCP_QUICKACK,
+     offsetof(struct tcp_tuning, quickack), 1},
+#endif
+#ifdef SO_BUSY_POLL
+    {"busy-poll", SOL_SOCKET, SO_BUSY_POLL,
+     offsetof(struct tcp_tuning, busy_poll), 0},
+#endif
+    {"sndbuf", SOL_SOCKET, SO_SNDBUF, offsetof(struct tcp_tuning, sndbuf), 0},
+    {"rcvbuf", SOL_SOCKET, SO_RCVBUF, offsetof(struct tcp_tuning, rcvbuf), 0},
+#ifdef TCP_NOTSENT_LOWAT
+    {"notsent-lowat", IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+     offsetof(struct tcp_tuning, notsent_lowat), 0},
+#endif
+#ifdef SO_PRIORITY
+    {"so-priority", SOL_SOCKET, SO_PRIORITY,
+     offsetof(struct tcp_tuning, priority), 0},
+#endif
+};
+
+#define NOPTIONS (sizeof(options) / sizeof(options[0]))
+
+static int *option_value(size_t o)
+{
+    return (int *)((char *)&tcp_opts + options[o].offset);
+}
+
+int tcp_tuning_parse_options(int *argc, char *argv[])
+{
+    for (size_t o = 0; o < NOPTIONS; o++) {
+        const char *value;
+
+        if (!options[o].flag) {
+            if (bench_take_int_option(argc, argv, options[o].name, 0,
+                                      option_value(o))) {
+                return -1;
+            }
+            continue;
+        }
+        value = bench_take_option(argc, argv, options[o].name);
+        if (value == NULL) {
+            continue;
+        }
+        if (*value == '\0' || strcmp(value, "1") == 0) {
+            *option_value(o) = 1;
+        } else if (strcmp(value, "0") == 0) {
+            *option_value(o) = 0;
+        } else {
+            fprintf(stderr, "bad value for --%s: '%s'\n", options[o].name,
+                    value);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+const char *tcp_tuning_usage(void)
+{
+    return "tcp options, set on both ends, unset ones keep the default:\n"
+           "  --nodelay[=0|1]  TCP_NODELAY\n"
+           "  --cork[=0|1]     TCP_CORK, partial segments wait up to 200ms\n"
+           "  --quickack[=0|1] TCP_QUICKACK, armed again after every read\n"
+           "  --busy-poll=US   SO_BUSY_POLL\n"
+           "  --sndbuf=N       SO_SNDBUF\n"
+           "  --rcvbuf=N       SO_RCVBUF\n"
+           "  --notsent-lowat=N TCP_NOTSENT_LOWAT\n"
+           "  --so-priority=N  SO_PRIORITY\n";
+}
+
+void tcp_tuning_print(void)
+{
+    const char *sep = " ";
+
+    printf("tcp options:");
+    for (size_t o = 0; o < NOPTIONS; o++) {
+        if (*option_value(o) >= 0) {
+            printf("%s%s=%d", sep, options[o].name, *option_value(o));
+            sep = ", ";
+        }
+    }
+    printf("%s\n", *sep == ' ' ? " default" : "");
+}
+
+int tcp_tuning_given(void)
+{
+    for (size_t o = 0; o < NOPTIONS; o++) {
+        if (*option_value(o) >= 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int tcp_tuning_apply(int fd)
+{
+    for (size_t o = 0; o < NOPTIONS; o++) {
+        int value = *option_value(o);
+
+        if (value >= 0 && setsockopt(fd, options[o].level, options[o].option,
+                                     &value, sizeof(value)) == -1) {
+            fprintf(stderr, "setsockopt %s: ", options[o].name);
+            perror(NULL);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void tcp_tuning_rearm(int fd)
+{
+#ifdef TCP_QUICKACK
+    int yes = 1;
+
+    if (tcp_opts.quickack == 1) {
+        setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &yes, sizeof(yes));
+    }
+#else
+    (void)fd;
+#endif
+}
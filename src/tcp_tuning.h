@@ -0,0 +1,60 @@
+/*
+    TCP socket options shared by the TCP benchmarks
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_TCP_TUNING_H
+#define IPC_BENCH_TCP_TUNING_H
+
+/* -1 for an option that was not given */
+struct tcp_tuning {
+    int nodelay;       /* TCP_NODELAY, 0 or 1 */
+    int cork;          /* TCP_CORK, 0 or 1 */
+    int quickack;      /* TCP_QUICKACK, set again after every read */
+    int busy_poll;     /* SO_BUSY_POLL in microseconds */
+    int sndbuf;        /* SO_SNDBUF */
+    int rcvbuf;        /* SO_RCVBUF */
+    int notsent_lowat; /* TCP_NOTSENT_LOWAT */
+    int priority;      /* SO_PRIORITY */
+};
+
+extern struct tcp_tuning tcp_opts;
+
+/* Take the TCP socket options out of argv */
+int tcp_tuning_parse_options(int *argc, char *argv[]);
+const char *tcp_tuning_usage(void);
+void tcp_tuning_print(void);
+/* Whether any of the options was given */
+int tcp_tuning_given(void);
+
+/* Apply the options to a socket. Buffer sizes only take full effect on
+ * the window scale when set before listen or connect, the other options
+ * are inherited by accepted sockets as well. */
+int tcp_tuning_apply(int fd);
+/* Quick ack mode ends on its own, so it is armed again after reads */
+void tcp_tuning_rearm(int fd);
+
+#endif
@@ -0,0 +1,88 @@
+/*
+    Transport plugins of the ipcbench driver
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_TRANSPORT_H
+#define IPC_BENCH_TRANSPORT_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+enum transport_side {
+    SIDE_PARENT,
+    SIDE_CHILD,
+};
+
+/* A transport moves messages between the parent and its peer, a forked
+ * process or a thread. setup runs first and creates everything both sides
+ * share, open runs on each side and returns its endpoint; it must not
+ * release anything the other side may still use in the same process.
+ * Both sides know the size of every message from the workload, so recv is
+ * told the size it has to receive and stream transports need no framing. */
+struct transport {
+    const char *name;
+    const char *description;
+    size_t max_size;  /* largest message, 0 if only limited by the system */
+    size_t headroom;  /* bytes in front of the payload send may overwrite */
+    int payload;      /* 0 if only a wakeup crosses, the data does not */
+    int lossy;        /* may drop messages, so only usable for latency */
+
+    void *(*setup)(size_t max_size);
+    void *(*open)(void *shared, enum transport_side side);
+    /* return 0, or -1 after printing a diagnostic */
+    int (*send)(void *ep, void *buf, size_t len);
+    /* return the length of the received message or -1, a lossy transport
+     * TRANSPORT_LOST once it gave up waiting for it */
+    ssize_t (*recv)(void *ep, void *buf, size_t len);
+    void (*close)(void *ep);
+};
+
+#define TRANSPORT_LOST -2
+
+extern const struct transport transport_pipe;
+extern const struct transport transport_unix;
+extern const struct transport transport_tcp;
+extern const struct transport transport_udp;
+extern const struct transport transport_sysv_msgqueue;
+extern const struct transport transport_sysv_semaphore;
+#ifndef __APPLE__
+extern const struct transport transport_posix_msgqueue;
+extern const struct transport transport_posix_sharedmem;
+#endif
+
+/* Endpoint of the transports that use one file descriptor per direction */
+struct fd_endpoint {
+    int in;
+    int out;
+};
+
+struct fd_endpoint *fd_endpoint_new(int in, int out);
+int fd_endpoint_send(void *ep, void *buf, size_t len);
+ssize_t fd_endpoint_recv(void *ep, void *buf, size_t len);
+void fd_endpoint_close(void *ep);
+
+#endif
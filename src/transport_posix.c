@@ -0,0 +1,267 @@
+/*
+    POSIX message queue and shared memory transports
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "transport.h"
+
+#include "bench.h"
+#include "memory.h"
+
+#include <fcntl.h>
+#include <mqueue.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct posix_msgqueue {
+    mqd_t down;
+    mqd_t up;
+    size_t msgsize;
+    int side;
+};
+
+static mqd_t open_queue(const char *dir, size_t msgsize)
+{
+    struct mq_attr attr;
+    char name[64];
+    mqd_t mq;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.mq_maxmsg = 10;
+    attr.mq_msgsize = msgsize;
+
+    /* unlinked right away, the descriptor is inherited over fork */
+    snprintf(name, sizeof(name), "/ipcbench-%s-%ld", dir, (long)getpid());
+    mq = mq_open(name, O_RDWR | O_CREAT | O_EXCL, 0600, &attr);
+    if (mq == (mqd_t)-1) {
+        perror("mq_open");
+        return mq;
+    }
+    mq_unlink(name);
+    return mq;
+}
+
+static void *posix_msgqueue_setup(size_t max_size)
+{
+    struct posix_msgqueue *q = malloc(sizeof(*q));
+
+    if (q == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    q->msgsize = max_size > 0 ? max_size : 1;
+    q->down = open_queue("down", q->msgsize);
+    q->up = open_queue("up", q->msgsize);
+    if (q->down == (mqd_t)-1 || q->up == (mqd_t)-1) {
+        return NULL;
+    }
+    return q;
+}
+
+static void *posix_msgqueue_open(void *shared, enum transport_side side)
+{
+    struct posix_msgqueue *q = malloc(sizeof(*q));
+
+    if (q == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    *q = *(struct posix_msgqueue *)shared;
+    q->side = side;
+    return q;
+}
+
+static int posix_msgqueue_send(void *ep, void *buf, size_t len)
+{
+    struct posix_msgqueue *q = ep;
+
+    if (mq_send(q->side == SIDE_PARENT ? q->down : q->up, buf, len, 0)) {
+        perror("mq_send");
+        return -1;
+    }
+    return 0;
+}
+
+static ssize_t posix_msgqueue_recv(void *ep, void *buf, size_t len)
+{
+    struct posix_msgqueue *q = ep;
+    ssize_t n;
+
+    /* mq_receive wants room for the largest message of the queue, which
+     * the buffer has */
+    (void)len;
+    n = mq_receive(q->side == SIDE_PARENT ? q->up : q->down, buf, q->msgsize,
+                   NULL);
+    if (n == -1) {
+        perror("mq_receive");
+    }
+    return n;
+}
+
+static void posix_msgqueue_close(void *ep)
+{
+    struct posix_msgqueue *q = ep;
+
+    /* the descriptors are shared with a peer thread */
+    if (q->side == SIDE_PARENT) {
+        mq_close(q->down);
+        mq_close(q->up);
+    }
+    free(q);
+}
+
+const struct transport transport_posix_msgqueue = {
+    .name = "posix_msgqueue",
+    .description = "POSIX message queues",
+    .payload = 1,
+    .setup = posix_msgqueue_setup,
+    .open = posix_msgqueue_open,
+    .send = posix_msgqueue_send,
+    .recv = posix_msgqueue_recv,
+    .close = posix_msgqueue_close,
+};
+
+/* One message slot per direction, guarded by a pair of semaphores */
+struct shm_slot {
+    sem_t full;
+    sem_t empty;
+    size_t len;
+    char data[];
+};
+
+struct posix_sharedmem {
+    struct shm_slot *down;
+    struct shm_slot *up;
+    int side;
+};
+
+static void *posix_sharedmem_setup(size_t max_size)
+{
+    struct posix_sharedmem *s = malloc(sizeof(*s));
+    size_t slot_size = sizeof(struct shm_slot) + max_size;
+    char name[64];
+    char *shm;
+    int fd;
+
+    if (s == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    /* keep the second slot aligned for its semaphores */
+    slot_size = (slot_size + 63) & ~(size_t)63;
+    if (bench_opts.pages != PAGES_DEFAULT) {
+        /* shm_open cannot give huge pages */
+        shm = memory_alloc_shared(2 * slot_size);
+        if (shm == NULL) {
+            return NULL;
+        }
+    } else {
+        snprintf(name, sizeof(name), "/ipcbench-%ld", (long)getpid());
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd == -1) {
+            perror("shm_open()");
+            return NULL;
+        }
+        if (ftruncate(fd, 2 * slot_size)) {
+            perror("ftruncate()");
+            return NULL;
+        }
+        shm = mmap(NULL, 2 * slot_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+        if (MAP_FAILED == shm) {
+            perror("mmap()");
+            return NULL;
+        }
+        close(fd);
+        shm_unlink(name);
+    }
+
+    s->down = (struct shm_slot *)shm;
+    s->up = (struct shm_slot *)(shm + slot_size);
+    if (sem_init(&s->down->full, 1, 0) || sem_init(&s->down->empty, 1, 1) ||
+            sem_init(&s->up->full, 1, 0) || sem_init(&s->up->empty, 1, 1)) {
+        perror("sem_init()");
+        return NULL;
+    }
+    return s;
+}
+
+static void *posix_sharedmem_open(void *shared, enum transport_side side)
+{
+    struct posix_sharedmem *s = malloc(sizeof(*s));
+
+    if (s == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    *s = *(struct posix_sharedmem *)shared;
+    s->side = side;
+    return s;
+}
+
+static int posix_sharedmem_send(void *ep, void *buf, size_t len)
+{
+    struct posix_sharedmem *s = ep;
+    struct shm_slot *slot = s->side == SIDE_PARENT ? s->down : s->up;
+
+    sem_wait(&slot->empty);
+    memcpy(slot->data, buf, len);
+    slot->len = len;
+    sem_post(&slot->full);
+    return 0;
+}
+
+static ssize_t posix_sharedmem_recv(void *ep, void *buf, size_t len)
+{
+    struct posix_sharedmem *s = ep;
+    struct shm_slot *slot = s->side == SIDE_PARENT ? s->up : s->down;
+
+    sem_wait(&slot->full);
+    len = slot->len;
+    memcpy(buf, slot->data, len);
+    sem_post(&slot->empty);
+    return len;
+}
+
+static void posix_sharedmem_close(void *ep)
+{
+    free(ep);
+}
+
+const struct transport transport_posix_sharedmem = {
+    .name = "posix_sharedmem",
+    .description = "POSIX shared memory with process shared semaphores",
+    .payload = 1,
+    .setup = posix_sharedmem_setup,
+    .open = posix_sharedmem_open,
+    .send = posix_sharedmem_send,
+    .recv = posix_sharedmem_recv,
+    .close = posix_sharedmem_close,
+};
@@ -0,0 +1,265 @@
+/*
+    TCP and UDP loopback transports
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "transport.h"
+
+#include "tcp_tuning.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/* Until the parent gives up on a datagram; the child waits twice as long,
+ * so only a parent that is done leaves it waiting that long */
+#define UDP_TIMEOUT_MS 1000
+
+/* A socket bound to an ephemeral loopback port, so concurrent runs do not
+ * collide and no sleep is needed before connecting */
+static int bind_loopback(int type, struct sockaddr_in *addr)
+{
+    socklen_t len = sizeof(*addr);
+    int fd = socket(AF_INET, type, 0);
+
+    if (fd == -1) {
+        perror("socket");
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)addr, sizeof(*addr)) == -1) {
+        perror("bind");
+        return -1;
+    }
+    if (getsockname(fd, (struct sockaddr *)addr, &len) == -1) {
+        perror("getsockname");
+        return -1;
+    }
+    return fd;
+}
+
+struct tcp_shared {
+    int listener;
+    struct sockaddr_in addr;
+};
+
+static void *tcp_setup(size_t max_size)
+{
+    struct tcp_shared *t = malloc(sizeof(*t));
+
+    (void)max_size;
+    if (t == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    /* listening before fork, the parent's connect cannot race the child */
+    t->listener = bind_loopback(SOCK_STREAM, &t->addr);
+    if (t->listener == -1 || tcp_tuning_apply(t->listener)) {
+        return NULL;
+    }
+    if (listen(t->listener, 1) == -1) {
+        perror("listen");
+        return NULL;
+    }
+    return t;
+}
+
+static void *tcp_open(void *shared, enum transport_side side)
+{
+    struct tcp_shared *t = shared;
+    int fd;
+
+    if (side == SIDE_CHILD) {
+        fd = accept(t->listener, NULL, NULL);
+        if (fd == -1) {
+            perror("accept");
+            return NULL;
+        }
+        close(t->listener);
+    } else {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd == -1) {
+            perror("socket");
+            return NULL;
+        }
+        if (tcp_tuning_apply(fd)) {
+            return NULL;
+        }
+        if (connect(fd, (struct sockaddr *)&t->addr, sizeof(t->addr)) == -1) {
+            perror("connect");
+            return NULL;
+        }
+    }
+    if (tcp_tuning_apply(fd)) {
+        return NULL;
+    }
+    return fd_endpoint_new(fd, fd);
+}
+
+const struct transport transport_tcp = {
+    .name = "tcp",
+    .description = "TCP connection over loopback",
+    .payload = 1,
+    .setup = tcp_setup,
+    .open = tcp_open,
+    .send = fd_endpoint_send,
+    .recv = fd_endpoint_recv,
+    .close = fd_endpoint_close,
+};
+
+static void *udp_setup(size_t max_size)
+{
+    struct sockaddr_in addr[2];
+    int *fds = malloc(2 * sizeof(int));
+
+    (void)max_size;
+    if (fds == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    for (int s = 0; s < 2; s++) {
+        fds[s] = bind_loopback(SOCK_DGRAM, &addr[s]);
+        if (fds[s] == -1) {
+            return NULL;
+        }
+    }
+    for (int s = 0; s < 2; s++) {
+        if (connect(fds[s], (struct sockaddr *)&addr[1 - s],
+                    sizeof(addr[1 - s])) == -1) {
+            perror("connect");
+            return NULL;
+        }
+    }
+    return fds;
+}
+
+/* Requests carry a sequence number in the headroom, which the child
+ * echoes, so the parent can tell late replies to requests it gave up on */
+struct udp_endpoint {
+    int fd;
+    enum transport_side side;
+    uint64_t sent; /* sequence number of the last request */
+    int64_t late;  /* replies dropped for arriving after the timeout */
+};
+
+static void *udp_open(void *shared, enum transport_side side)
+{
+    int *fds = shared;
+    int ms = side == SIDE_CHILD ? 2 * UDP_TIMEOUT_MS : UDP_TIMEOUT_MS;
+    struct timeval timeout = {ms / 1000, (ms % 1000) * 1000};
+    struct udp_endpoint *e = calloc(1, sizeof(*e));
+
+    if (e == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    e->fd = side == SIDE_CHILD ? fds[1] : fds[0];
+    e->side = side;
+    if (setsockopt(e->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                   sizeof(timeout)) == -1) {
+        perror("setsockopt SO_RCVTIMEO");
+        free(e);
+        return NULL;
+    }
+    return e;
+}
+
+/* buf is preceded by the sequence number, see headroom */
+static int udp_send(void *ep, void *buf, size_t len)
+{
+    struct udp_endpoint *e = ep;
+    char *dgram = (char *)buf - sizeof(e->sent);
+
+    if (e->side == SIDE_PARENT) {
+        e->sent++;
+        memcpy(dgram, &e->sent, sizeof(e->sent));
+    }
+    len += sizeof(e->sent);
+    if (send(e->fd, dgram, len, 0) != (ssize_t)len) {
+        perror("send");
+        return -1;
+    }
+    return 0;
+}
+
+static ssize_t udp_recv(void *ep, void *buf, size_t len)
+{
+    struct udp_endpoint *e = ep;
+    char *dgram = (char *)buf - sizeof(e->sent);
+    uint64_t seq;
+    ssize_t n;
+
+    for (;;) {
+        n = recv(e->fd, dgram, len + sizeof(seq), 0);
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return TRANSPORT_LOST;
+        }
+        if (n < (ssize_t)sizeof(seq)) {
+            perror("recv");
+            return -1;
+        }
+        memcpy(&seq, dgram, sizeof(seq));
+        if (e->side == SIDE_CHILD || seq == e->sent) {
+            return n - sizeof(seq);
+        }
+        e->late++;
+    }
+}
+
+static void udp_close(void *ep)
+{
+    struct udp_endpoint *e = ep;
+
+    if (e->late > 0) {
+        printf("udp: %li late replies dropped\n", (long)e->late);
+    }
+    close(e->fd);
+    free(e);
+}
+
+const struct transport transport_udp = {
+    .name = "udp",
+    .description = "connected UDP sockets over loopback",
+    .max_size = 65507 - sizeof(uint64_t),
+    .headroom = sizeof(uint64_t),
+    .payload = 1,
+    .lossy = 1,
+    .setup = udp_setup,
+    .open = udp_open,
+    .send = udp_send,
+    .recv = udp_recv,
+    .close = udp_close,
+};
@@ -0,0 +1,156 @@
+/*
+    Pipe and unix domain socket transports
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "transport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "workload.h"
+
+struct fd_endpoint *fd_endpoint_new(int in, int out)
+{
+    struct fd_endpoint *ep = malloc(sizeof(*ep));
+
+    if (ep == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    ep->in = in;
+    ep->out = out;
+    return ep;
+}
+
+int fd_endpoint_send(void *ep, void *buf, size_t len)
+{
+    if (write_full(((struct fd_endpoint *)ep)->out, buf, len)) {
+        perror("write");
+        return -1;
+    }
+    return 0;
+}
+
+ssize_t fd_endpoint_recv(void *ep, void *buf, size_t len)
+{
+    if (read_full(((struct fd_endpoint *)ep)->in, buf, len)) {
+        perror("read");
+        return -1;
+    }
+    return len;
+}
+
+void fd_endpoint_close(void *ep)
+{
+    struct fd_endpoint *e = ep;
+
+    close(e->in);
+    if (e->out != e->in) {
+        close(e->out);
+    }
+    free(e);
+}
+
+/* down carries parent to child, up child to parent */
+struct pipe_pair {
+    int down[2];
+    int up[2];
+};
+
+static void *pipe_setup(size_t max_size)
+{
+    struct pipe_pair *p = malloc(sizeof(*p));
+
+    (void)max_size;
+    if (p == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    if (pipe(p->down) == -1 || pipe(p->up) == -1) {
+        perror("pipe");
+        return NULL;
+    }
+    return p;
+}
+
+static void *pipe_open(void *shared, enum transport_side side)
+{
+    struct pipe_pair *p = shared;
+
+    if (side == SIDE_CHILD) {
+        return fd_endpoint_new(p->down[0], p->up[1]);
+    }
+    return fd_endpoint_new(p->up[0], p->down[1]);
+}
+
+const struct transport transport_pipe = {
+    .name = "pipe",
+    .description = "a pair of pipes",
+    .payload = 1,
+    .setup = pipe_setup,
+    .open = pipe_open,
+    .send = fd_endpoint_send,
+    .recv = fd_endpoint_recv,
+    .close = fd_endpoint_close,
+};
+
+static void *unix_setup(size_t max_size)
+{
+    int *fds = malloc(2 * sizeof(int));
+
+    (void)max_size;
+    if (fds == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+        perror("socketpair");
+        return NULL;
+    }
+    return fds;
+}
+
+static void *unix_open(void *shared, enum transport_side side)
+{
+    int *fds = shared;
+    int mine = side == SIDE_CHILD ? fds[1] : fds[0];
+
+    return fd_endpoint_new(mine, mine);
+}
+
+const struct transport transport_unix = {
+    .name = "unix",
+    .description = "unix domain stream socketpair",
+    .payload = 1,
+    .setup = unix_setup,
+    .open = unix_open,
+    .send = fd_endpoint_send,
+    .recv = fd_endpoint_recv,
+    .close = fd_endpoint_close,
+};
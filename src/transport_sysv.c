@@ -0,0 +1,203 @@
+/*
+    System V message queue and semaphore transports
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "transport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <sys/sem.h>
+
+/* mtype of the messages in each direction */
+#define MTYPE_DOWN 1
+#define MTYPE_UP 2
+
+struct sysv_endpoint {
+    int id;
+    int side;
+};
+
+static void *sysv_endpoint_new(int id, enum transport_side side)
+{
+    struct sysv_endpoint *ep = malloc(sizeof(*ep));
+
+    if (ep == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    ep->id = id;
+    ep->side = side;
+    return ep;
+}
+
+static void *sysv_msgqueue_setup(size_t max_size)
+{
+    int *id = malloc(sizeof(int));
+
+    (void)max_size;
+    if (id == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    /* one queue, the direction is told apart by mtype */
+    *id = msgget(IPC_PRIVATE, 0644 | IPC_CREAT | IPC_EXCL);
+    if (*id == -1) {
+        perror("msgget");
+        return NULL;
+    }
+    return id;
+}
+
+static void *sysv_open(void *shared, enum transport_side side)
+{
+    return sysv_endpoint_new(*(int *)shared, side);
+}
+
+/* buf is preceded by the mtype, see headroom */
+static int sysv_msgqueue_send(void *ep, void *buf, size_t len)
+{
+    struct sysv_endpoint *e = ep;
+    long *mtype = (long *)buf - 1;
+
+    *mtype = e->side == SIDE_PARENT ? MTYPE_DOWN : MTYPE_UP;
+    if (msgsnd(e->id, mtype, len, 0)) {
+        perror("msgsnd");
+        return -1;
+    }
+    return 0;
+}
+
+static ssize_t sysv_msgqueue_recv(void *ep, void *buf, size_t len)
+{
+    struct sysv_endpoint *e = ep;
+    ssize_t n;
+
+    n = msgrcv(e->id, (long *)buf - 1, len,
+               e->side == SIDE_PARENT ? MTYPE_UP : MTYPE_DOWN, 0);
+    if (n == -1) {
+        perror("msgrcv");
+    }
+    return n;
+}
+
+static void sysv_msgqueue_close(void *ep)
+{
+    struct sysv_endpoint *e = ep;
+
+    if (e->side == SIDE_PARENT) {
+        msgctl(e->id, IPC_RMID, NULL);
+    }
+    free(e);
+}
+
+const struct transport transport_sysv_msgqueue = {
+    .name = "sysv_msgqueue",
+    .description = "System V message queue",
+    .headroom = sizeof(long),
+    .payload = 1,
+    .setup = sysv_msgqueue_setup,
+    .open = sysv_open,
+    .send = sysv_msgqueue_send,
+    .recv = sysv_msgqueue_recv,
+    .close = sysv_msgqueue_close,
+};
+
+/* Semaphore 0 wakes the child, semaphore 1 the parent */
+static void *sysv_semaphore_setup(size_t max_size)
+{
+    int *id = malloc(sizeof(int));
+
+    (void)max_size;
+    if (id == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    *id = semget(IPC_PRIVATE, 2, 0600 | IPC_CREAT | IPC_EXCL);
+    if (*id == -1) {
+        perror("semget");
+        return NULL;
+    }
+    return id;
+}
+
+static int sysv_semaphore_op(struct sysv_endpoint *e, int num, int op)
+{
+    struct sembuf sop = {
+        .sem_num = num,
+        .sem_op = op,
+        .sem_flg = 0
+    };
+
+    if (semop(e->id, &sop, 1)) {
+        perror("semop");
+        return -1;
+    }
+    return 0;
+}
+
+static int sysv_semaphore_send(void *ep, void *buf, size_t len)
+{
+    struct sysv_endpoint *e = ep;
+
+    (void)buf;
+    (void)len;
+    return sysv_semaphore_op(e, e->side == SIDE_PARENT ? 0 : 1, 1);
+}
+
+static ssize_t sysv_semaphore_recv(void *ep, void *buf, size_t len)
+{
+    struct sysv_endpoint *e = ep;
+
+    (void)buf;
+    if (sysv_semaphore_op(e, e->side == SIDE_PARENT ? 1 : 0, -1)) {
+        return -1;
+    }
+    return len;
+}
+
+static void sysv_semaphore_close(void *ep)
+{
+    struct sysv_endpoint *e = ep;
+
+    if (e->side == SIDE_PARENT) {
+        semctl(e->id, 0, IPC_RMID);
+    }
+    free(e);
+}
+
+const struct transport transport_sysv_semaphore = {
+    .name = "sysv_semaphore",
+    .description = "System V semaphore wakeups, no payload",
+    .payload = 0,
+    .setup = sysv_semaphore_setup,
+    .open = sysv_open,
+    .send = sysv_semaphore_send,
+    .recv = sysv_semaphore_recv,
+    .close = sysv_semaphore_close,
+};
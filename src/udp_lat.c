@@ -26,6 +26,7 @@
     OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <errno.h>
 #include <netdb.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -33,46 +34,124 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
+#include "bench.h"
+#include "inet_family.h"
+#include "memory.h"
+#include "netns.h"
+#include "perf.h"
+#include "pipeline.h"
+#include "ready_pipe.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
+
+/* Until a request counts as lost */
+static int timeout_ms = 1000;
+
+static int set_timeout(int fd, int ms)
+{
+    struct timeval timeout = {ms / 1000, (ms % 1000) * 1000};
+
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                   sizeof(timeout)) == -1) {
+        perror("setsockopt SO_RCVTIMEO");
+        return -1;
+    }
+    return 0;
+}
+
+static int is_timeout(ssize_t len)
+{
+    return len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+/* Every datagram carries a sequence number ahead of the message, which
+ * the child echoes. Returns the length of the message sent. */
+static ssize_t send_dgram(int fd, int64_t seq, char *buf, int size,
+                          struct sockaddr *to, socklen_t to_len)
+{
+    struct iovec iov[2] = {{&seq, sizeof(seq)}, {buf, size}};
+    struct msghdr msg;
+    ssize_t n;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = to;
+    msg.msg_namelen = to_len;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    n = sendmsg(fd, &msg, 0);
+    return n == -1 ? -1 : n - (ssize_t)sizeof(seq);
+}
+
+/* Returns the length of the message received, -1 on error or timeout */
+static ssize_t recv_dgram(int fd, int64_t *seq, char *buf, int size,
+                          struct sockaddr *from, socklen_t *from_len)
+{
+    struct iovec iov[2] = {{seq, sizeof(*seq)}, {buf, size}};
+    struct msghdr msg;
+    ssize_t n;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = from;
+    msg.msg_namelen = from_len != NULL ? *from_len : 0;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    n = recvmsg(fd, &msg, 0);
+    if (n == -1) {
+        return -1;
+    }
+    if (from_len != NULL) {
+        *from_len = msg.msg_namelen;
+    }
+    return n < (ssize_t)sizeof(*seq) ? 0 : n - (ssize_t)sizeof(*seq);
+}
 
 int main(int argc, char *argv[])
 {
     int size;
     char *buf;
-    int64_t count, i, delta;
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop;
-#else
-    struct timeval start, stop;
-#endif
+    int64_t count, i, delta, start;
+    int run;
+    struct run_stats stats;
+    struct pipeline pl;
+    int step;
+    int64_t seq, next_seq = 0, oldest, late = 0;
 
     ssize_t len;
-    size_t sofar;
 
     int yes = 1;
     int ret;
     struct addrinfo hints;
     struct addrinfo *resChild;
     struct addrinfo *resParent;
+    struct sockaddr_storage child_addr;
+    socklen_t child_len;
+    struct ready_pipe ready;
     int sockfd;
 
-    if (argc != 3) {
-        printf("usage: udp_lat <message-size> <roundtrip-count>\n");
+    if (inet_family_parse_options(&argc, argv) ||
+            netns_parse_options(&argc, argv) ||
+            pipeline_parse_options(&argc, argv) ||
+            bench_take_int_option(&argc, argv, "timeout", 1, &timeout_ms) ||
+            bench_parse_options(&argc, argv) || argc != 3) {
+        printf("usage: udp_lat [options] <message-size> <roundtrip-count>\n"
+               "  --timeout=MS     requests unanswered for MS are lost\n"
+               "                   (default 1000)\n"
+               "%s%s%s%s",
+               inet_family_usage(), netns_usage(), pipeline_usage(),
+               bench_usage());
         return 1;
     }
 
     size = atoi(argv[1]);
     count = atol(argv[2]);
 
-    buf = malloc(size);
+    buf = memory_alloc(size);
     if (buf == NULL) {
-        perror("malloc");
         return 1;
     }
 
@@ -80,19 +159,39 @@ int main(int argc, char *argv[])
     hints.ai_family = AF_UNSPEC; // use IPv4 or IPv6, whichever
     hints.ai_socktype = SOCK_DGRAM;
     hints.ai_flags = AI_PASSIVE; // fill in my IP for me
-    if ((ret = getaddrinfo("127.0.0.1", "3491", &hints, &resParent)) != 0) {
+    inet_family_hints(&hints);
+    if ((ret = getaddrinfo(netns_address(0), "0", &hints, &resParent)) != 0) {
         fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(ret));
         return 1;
     }
-    if ((ret = getaddrinfo("127.0.0.1", "3492", &hints, &resChild)) != 0) {
+    if ((ret = getaddrinfo(netns_address(1), "0", &hints, &resChild)) != 0) {
         fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(ret));
         return 1;
     }
 
     printf("message size: %i octets\n", size);
-    printf("roundtrip count: %lli\n", count);
+    printf("roundtrip count: %li\n", count);
+    inet_family_print();
+    netns_print();
+    pipeline_print();
+
+    /* requests are stamped, losses leave delta no measure of the latency */
+    if (run_stats_init(&stats, "latency", "ns", bench_opts.runs) ||
+            pipeline_init(&pl, count, 1)) {
+        return 1;
+    }
+
+    if (perf_counters_init(1) || ready_pipe_init(&ready) || netns_init()) {
+        return 1;
+    }
 
     if (!fork()) { /* child */
+        if (netns_enter_child()) {
+            return 1;
+        }
+        realtime_enter_peer();
+        perf_counters_open(1);
+        bench_prefault(buf, size);
 
         if ((sockfd = socket(resChild->ai_family, resChild->ai_socktype, resChild->ai_protocol)) ==
                 -1) {
@@ -105,30 +204,52 @@ int main(int argc, char *argv[])
             return 1;
         }
 
+        if (inet_family_apply(sockfd)) {
+            return 1;
+        }
+
         if (bind(sockfd, resChild->ai_addr, resChild->ai_addrlen) == -1) {
             perror("bind");
             return 1;
         }
 
-        for (i = 0; i < count; i++) {
+        /* outlasts the parent writing off a window, so only a parent
+         * that is done leaves the child waiting that long */
+        if (set_timeout(sockfd, 2 * timeout_ms)) {
+            return 1;
+        }
 
-            for (sofar = 0; sofar < size;) {
-                len = recvfrom(sockfd, buf, size - sofar, 0, resParent->ai_addr, &resParent->ai_addrlen);
-                if (len == -1) {
-                    perror("recvfrom");
-                    return 1;
-                }
-                sofar += len;
+        /* the parent's address comes with its first datagram */
+        if (ready_pipe_signal(&ready, sockfd)) {
+            return 1;
+        }
+
+        for (i = 0; i < bench_peer_iterations(count); i++) {
+            perf_counters_peer_mark(i, count);
+
+            len = recv_dgram(sockfd, &seq, buf, size, resParent->ai_addr,
+                             &resParent->ai_addrlen);
+            if (is_timeout(len)) {
+                break; /* short of the requests that were lost */
+            }
+            if (len == -1) {
+                perror("recvmsg");
+                return 1;
             }
 
-            if (sendto(sockfd, buf, size, 0, resParent->ai_addr, resParent->ai_addrlen) != size) {
-                perror("sendto");
+            if (send_dgram(sockfd, seq, buf, size, resParent->ai_addr,
+                           resParent->ai_addrlen) != size) {
+                perror("sendmsg");
                 return 1;
             }
         }
+        perf_counters_stop();
     } else { /* parent */
+        bench_prefault(buf, size);
 
-        sleep(1);
+        if (netns_setup() || ready_pipe_wait(&ready, &child_addr, &child_len)) {
+            return 1;
+        }
 
         if ((sockfd = socket(resParent->ai_family, resParent->ai_socktype, resParent->ai_protocol)) ==
                 -1) {
@@ -141,61 +262,83 @@ int main(int argc, char *argv[])
             return 1;
         }
 
-        if (bind(sockfd, resParent->ai_addr, resParent->ai_addrlen) == -1) {
-            perror("bind");
+        if (inet_family_apply(sockfd)) {
             return 1;
         }
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-            perror("clock_gettime");
+        if (bind(sockfd, resParent->ai_addr, resParent->ai_addrlen) == -1) {
+            perror("bind");
             return 1;
         }
-#else
-        if (gettimeofday(&start, NULL) == -1) {
-            perror("gettimeofday");
+
+        if (set_timeout(sockfd, timeout_ms) ||
+                pipeline_check_fits(pipeline_socket_holds(sockfd, SO_RCVBUF,
+                                                          size + sizeof(seq)),
+                                    size, "socket receive buffer")) {
             return 1;
         }
-#endif
 
-        for (i = 0; i < count; i++) {
-
-            if (sendto(sockfd, buf, size, 0, resChild->ai_addr, resChild->ai_addrlen) != size) {
-                perror("sendto");
-                return 1;
+        perf_counters_open(0);
+        for (run = bench_first_run(); run < bench_total_runs(); run++) {
+            if (run == bench_opts.warmup_runs) {
+                perf_counters_start();
             }
+            pipeline_start(&pl);
+            start = now_ns();
+
+            while ((step = pipeline_next(&pl, run)) >= 0) {
+                if (step) {
+                    pipeline_sent(&pl);
+                    if (send_dgram(sockfd, next_seq++, buf, size,
+                                   (struct sockaddr *)&child_addr,
+                                   child_len) != size) {
+                        perror("sendmsg");
+                        return 1;
+                    }
+                    continue;
+                }
 
-            for (sofar = 0; sofar < size;) {
-                len = recvfrom(sockfd, buf, size - sofar, 0, resChild->ai_addr, &resChild->ai_addrlen);
+                len = recv_dgram(sockfd, &seq, buf, size, NULL, NULL);
+                if (is_timeout(len)) {
+                    /* nothing came back within the timeout, write off
+                     * the window */
+                    while (pl.received < pl.sent) {
+                        pipeline_lost(&pl, run);
+                    }
+                    continue;
+                }
                 if (len == -1) {
-                    perror("read");
+                    perror("recvmsg");
                     return 1;
                 }
-                sofar += len;
+                oldest = next_seq - (pl.sent - pl.received);
+                if (seq < oldest) {
+                    late++; /* its request was already written off */
+                    continue;
+                }
+                /* loopback keeps the order, so the requests ahead of this
+                 * one were lost on the way */
+                for (; oldest < seq && pl.received < pl.sent; oldest++) {
+                    pipeline_lost(&pl, run);
+                }
+                pipeline_received(&pl, run);
             }
-        }
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-            perror("clock_gettime");
-            return 1;
+            delta = now_ns() - start;
+            if (bench_warmup_done(run, pl.sent, delta)) {
+                continue;
+            }
+            run_stats_add(&stats, run, pipeline_latency(&pl, run, delta));
         }
+        perf_counters_stop();
 
-        delta = ((stop.tv_sec - start.tv_sec) * 1000000000 +
-                 (stop.tv_nsec - start.tv_nsec));
-
-#else
-        if (gettimeofday(&stop, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
+        run_stats_report(&stats);
+        pipeline_report(&pl);
+        if (late > 0) {
+            printf("late: %li replies after their request was lost\n",
+                   (long)late);
         }
-
-        delta =
-            (stop.tv_sec - start.tv_sec) * 1000000000 + (stop.tv_usec - start.tv_usec) * 1000;
-
-#endif
-
-        printf("average latency: %lli ns\n", delta / (count * 2));
+        perf_counters_report("roundtrip", count * bench_opts.runs);
     }
 
     return 0;
@@ -33,49 +33,75 @@
 #include <time.h>
 #include <unistd.h>
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
+#include "bench.h"
+#include "memory.h"
+#include "perf.h"
+#include "pipeline.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
+#include "unix_socket.h"
+#include "workload.h"
 
 int main(int argc, char *argv[])
 {
     int sv[2]; /* the pair of socket descriptors */
     int size;
     char *buf;
-    int64_t count, i, delta;
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop;
-#else
-    struct timeval start, stop;
-#endif
-
-    if (argc != 3) {
-        printf("usage: unix_lat <message-size> <roundtrip-count>\n");
+    int64_t count, i, delta, start;
+    int run;
+    struct run_stats stats;
+    struct pipeline pl;
+    int step;
+
+    if (unix_socket_parse_options(&argc, argv) ||
+            pipeline_parse_options(&argc, argv) ||
+            bench_parse_options(&argc, argv) || argc != 3) {
+        printf("usage: unix_lat [options] <message-size> <roundtrip-count>\n"
+               "%s%s%s",
+               unix_socket_usage(), pipeline_usage(), bench_usage());
         return 1;
     }
 
     size = atoi(argv[1]);
     count = atol(argv[2]);
 
-    buf = malloc(size);
+    buf = memory_alloc(size);
     if (buf == NULL) {
-        perror("malloc");
         return 1;
     }
 
     printf("message size: %i octets\n", size);
     printf("roundtrip count: %li\n", count);
 
-    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1) {
-        perror("socketpair");
+    unix_socket_print();
+    pipeline_print();
+    if (unix_socket_pair(sv)) {
+        return 1;
+    }
+    /* unix sockets charge what is queued to the sender's buffer */
+    if (pipeline_check_fits(pipeline_socket_holds(sv[1], SO_SNDBUF, size),
+                            size, "socket send buffer")) {
+        return 1;
+    }
+
+    if (run_stats_init(&stats, "latency", "ns", bench_opts.runs) ||
+            pipeline_init(&pl, count, 0)) {
+        return 1;
+    }
+
+    if (perf_counters_init(1)) {
         return 1;
     }
 
     if (!fork()) { /* child */
-        for (i = 0; i < count; i++) {
+        realtime_enter_peer();
+        perf_counters_open(1);
+        bench_prefault(buf, size);
+        for (i = 0; i < bench_peer_iterations(count); i++) {
+            perf_counters_peer_mark(i, count);
 
-            if (read(sv[1], buf, size) != size) {
+            if (read_full(sv[1], buf, size)) {
                 perror("read");
                 return 1;
             }
@@ -85,54 +111,46 @@ int main(int argc, char *argv[])
                 return 1;
             }
         }
+        perf_counters_stop();
     } else { /* parent */
+        bench_prefault(buf, size);
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-            perror("clock_gettime");
-            return 1;
-        }
-#else
-        if (gettimeofday(&start, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
-        }
-#endif
-
-        for (i = 0; i < count; i++) {
-
-            if (write(sv[0], buf, size) != size) {
-                perror("write");
-                return 1;
+        perf_counters_open(0);
+        for (run = bench_first_run(); run < bench_total_runs(); run++) {
+            if (run == bench_opts.warmup_runs) {
+                perf_counters_start();
             }
-
-            if (read(sv[0], buf, size) != size) {
-                perror("read");
-                return 1;
+            pipeline_start(&pl);
+            start = now_ns();
+
+            while ((step = pipeline_next(&pl, run)) >= 0) {
+                if (step) {
+                    pipeline_sent(&pl);
+                    if (write(sv[0], buf, size) != size) {
+                        perror("write");
+                        return 1;
+                    }
+                    continue;
+                }
+
+                if (read_full(sv[0], buf, size)) {
+                    perror("read");
+                    return 1;
+                }
+                pipeline_received(&pl, run);
             }
-        }
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-            perror("clock_gettime");
-            return 1;
-        }
-
-        delta = ((stop.tv_sec - start.tv_sec) * 1000000000 +
-                 (stop.tv_nsec - start.tv_nsec));
-
-#else
-        if (gettimeofday(&stop, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
+            delta = now_ns() - start;
+            if (bench_warmup_done(run, pl.sent, delta)) {
+                continue;
+            }
+            run_stats_add(&stats, run, pipeline_latency(&pl, run, delta));
         }
+        perf_counters_stop();
 
-        delta =
-            (stop.tv_sec - start.tv_sec) * 1000000000 + (stop.tv_usec - start.tv_usec) * 1000;
-
-#endif
-
-        printf("average latency: %li ns\n", delta / (count * 2));
+        run_stats_report(&stats);
+        pipeline_report(&pl);
+        perf_counters_report("roundtrip", count * bench_opts.runs);
     }
 
     return 0;
@@ -0,0 +1,248 @@
+/*
+    Unix domain socket types, addressing and buffer sizes
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "unix_socket.h"
+
+#include "bench.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct unix_socket_options unix_opts = {
+    .type = SOCK_STREAM,
+    .address = UNIX_ADDR_PAIR,
+    .sndbuf = 0,
+    .rcvbuf = 0,
+};
+
+static const char *type_name(int type)
+{
+    switch (type) {
+    case SOCK_DGRAM:
+        return "dgram";
+    case SOCK_SEQPACKET:
+        return "seqpacket";
+    default:
+        return "stream";
+    }
+}
+
+static const char *address_names[] = {
+    [UNIX_ADDR_PAIR] = "socketpair",
+    [UNIX_ADDR_PATH] = "path",
+    [UNIX_ADDR_ABSTRACT] = "abstract",
+};
+
+int unix_socket_parse_options(int *argc, char *argv[])
+{
+    const char *type = bench_take_option(argc, argv, "socket-type");
+    const char *address = bench_take_option(argc, argv, "address");
+
+    if (type == NULL || strcmp(type, "stream") == 0) {
+        unix_opts.type = SOCK_STREAM;
+    } else if (strcmp(type, "dgram") == 0) {
+        unix_opts.type = SOCK_DGRAM;
+    } else if (strcmp(type, "seqpacket") == 0) {
+        unix_opts.type = SOCK_SEQPACKET;
+    } else {
+        fprintf(stderr, "bad value for --socket-type: '%s'\n", type);
+        return -1;
+    }
+
+    if (address == NULL || strcmp(address, "socketpair") == 0) {
+        unix_opts.address = UNIX_ADDR_PAIR;
+    } else if (strcmp(address, "path") == 0) {
+        unix_opts.address = UNIX_ADDR_PATH;
+    } else if (strcmp(address, "abstract") == 0) {
+#ifdef __linux__
+        unix_opts.address = UNIX_ADDR_ABSTRACT;
+#else
+        fprintf(stderr, "--address=abstract needs Linux\n");
+        return -1;
+#endif
+    } else {
+        fprintf(stderr, "bad value for --address: '%s'\n", address);
+        return -1;
+    }
+
+    if (bench_take_int_option(argc, argv, "sndbuf", 1, &unix_opts.sndbuf) ||
+            bench_take_int_option(argc, argv, "rcvbuf", 1, &unix_opts.rcvbuf)) {
+        return -1;
+    }
+    return 0;
+}
+
+const char *unix_socket_usage(void)
+{
+    return "unix socket options:\n"
+           "  --socket-type=T  stream (default), dgram or seqpacket\n"
+           "  --address=A      socketpair (default), path or abstract, bound\n"
+           "                   sockets are connected with connect/accept\n"
+           "  --sndbuf=N       set SO_SNDBUF of both sockets\n"
+           "  --rcvbuf=N       set SO_RCVBUF of both sockets\n";
+}
+
+void unix_socket_print(void)
+{
+    printf("socket: %s, %s", type_name(unix_opts.type),
+           address_names[unix_opts.address]);
+    if (unix_opts.sndbuf) {
+        printf(", sndbuf %d", unix_opts.sndbuf);
+    }
+    if (unix_opts.rcvbuf) {
+        printf(", rcvbuf %d", unix_opts.rcvbuf);
+    }
+    printf("\n");
+}
+
+/* Address number n of this process, the path is unlinked once connected */
+static socklen_t make_address(struct sockaddr_un *addr, int n)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (unix_opts.address == UNIX_ADDR_ABSTRACT) {
+        /* a leading NUL puts the name in the abstract namespace */
+        snprintf(addr->sun_path + 1, sizeof(addr->sun_path) - 1,
+                 "ipc-bench-%ld-%d", (long)getpid(), n);
+        return offsetof(struct sockaddr_un, sun_path) + 1 +
+               strlen(addr->sun_path + 1);
+    }
+    snprintf(addr->sun_path, sizeof(addr->sun_path), "/tmp/ipc-bench-%ld-%d",
+             (long)getpid(), n);
+    unlink(addr->sun_path);
+    return sizeof(*addr);
+}
+
+static void remove_address(const struct sockaddr_un *addr)
+{
+    if (unix_opts.address == UNIX_ADDR_PATH) {
+        unlink(addr->sun_path);
+    }
+}
+
+static int bound_socket(struct sockaddr_un *addr, socklen_t *len, int n)
+{
+    int fd = socket(AF_UNIX, unix_opts.type, 0);
+
+    if (fd == -1) {
+        perror("socket");
+        return -1;
+    }
+    *len = make_address(addr, n);
+    if (bind(fd, (struct sockaddr *)addr, *len) == -1) {
+        perror("bind");
+        return -1;
+    }
+    return fd;
+}
+
+static int connect_bound(int fds[2])
+{
+    struct sockaddr_un addr[2];
+    socklen_t len[2];
+    int listener;
+
+    if (unix_opts.type == SOCK_DGRAM) {
+        for (int n = 0; n < 2; n++) {
+            fds[n] = bound_socket(&addr[n], &len[n], n);
+            if (fds[n] == -1) {
+                return -1;
+            }
+        }
+        for (int n = 0; n < 2; n++) {
+            if (connect(fds[n], (struct sockaddr *)&addr[1 - n],
+                        len[1 - n]) == -1) {
+                perror("connect");
+                return -1;
+            }
+        }
+        remove_address(&addr[0]);
+        remove_address(&addr[1]);
+        return 0;
+    }
+
+    listener = bound_socket(&addr[0], &len[0], 0);
+    if (listener == -1) {
+        return -1;
+    }
+    if (listen(listener, 1) == -1) {
+        perror("listen");
+        return -1;
+    }
+    /* completes against the backlog before accept is called */
+    fds[0] = socket(AF_UNIX, unix_opts.type, 0);
+    if (fds[0] == -1) {
+        perror("socket");
+        return -1;
+    }
+    if (connect(fds[0], (struct sockaddr *)&addr[0], len[0]) == -1) {
+        perror("connect");
+        return -1;
+    }
+    fds[1] = accept(listener, NULL, NULL);
+    if (fds[1] == -1) {
+        perror("accept");
+        return -1;
+    }
+    close(listener);
+    remove_address(&addr[0]);
+    return 0;
+}
+
+static int set_buffer(int fd, int option, int value)
+{
+    if (value && setsockopt(fd, SOL_SOCKET, option, &value, sizeof(value))) {
+        perror("setsockopt");
+        return -1;
+    }
+    return 0;
+}
+
+int unix_socket_pair(int fds[2])
+{
+    if (unix_opts.address == UNIX_ADDR_PAIR) {
+        if (socketpair(AF_UNIX, unix_opts.type, 0, fds) == -1) {
+            perror("socketpair");
+            return -1;
+        }
+    } else if (connect_bound(fds)) {
+        return -1;
+    }
+
+    for (int n = 0; n < 2; n++) {
+        if (set_buffer(fds[n], SO_SNDBUF, unix_opts.sndbuf) ||
+                set_buffer(fds[n], SO_RCVBUF, unix_opts.rcvbuf)) {
+            return -1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+/*
+    Unix domain socket types, addressing and buffer sizes
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_UNIX_SOCKET_H
+#define IPC_BENCH_UNIX_SOCKET_H
+
+enum unix_address {
+    UNIX_ADDR_PAIR,     /* socketpair, no address at all */
+    UNIX_ADDR_PATH,     /* bound to a filesystem path */
+    UNIX_ADDR_ABSTRACT, /* bound to a name in the abstract namespace */
+};
+
+struct unix_socket_options {
+    int type;                  /* SOCK_STREAM, SOCK_DGRAM or SOCK_SEQPACKET */
+    enum unix_address address;
+    int sndbuf;                /* SO_SNDBUF, 0 keeps the default */
+    int rcvbuf;                /* SO_RCVBUF, 0 keeps the default */
+};
+
+extern struct unix_socket_options unix_opts;
+
+/* Take --socket-type, --address, --sndbuf and --rcvbuf out of argv */
+int unix_socket_parse_options(int *argc, char *argv[]);
+const char *unix_socket_usage(void);
+void unix_socket_print(void);
+
+/* A connected pair of sockets as selected by the options, fds[0] for the
+ * parent and fds[1] for the child. Bound sockets are connected through
+ * listen/accept, or for datagrams connected to each other. */
+int unix_socket_pair(int fds[2]);
+
+#endif
@@ -33,99 +33,177 @@
 #include <time.h>
 #include <unistd.h>
 
-#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) &&                           \
-    defined(_POSIX_MONOTONIC_CLOCK)
-#define HAS_CLOCK_GETTIME_MONOTONIC
-#endif
+#include "bench.h"
+#include "memory.h"
+#include "payload.h"
+#include "perf.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
+#include "unix_socket.h"
+#include "workload.h"
 
 int main(int argc, char *argv[])
 {
     int fds[2]; /* the pair of socket descriptors */
+    int framed;
+    ssize_t len;
     int size;
     char *buf;
-    int64_t count, i, delta;
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-    struct timespec start, stop;
-#else
-    struct timeval start, stop;
-#endif
-
-    if (argc != 3) {
-        printf("usage: unix_thr <message-size> <message-count>\n");
+    int64_t count, i, delta, bytes, start, t0, seq = 0;
+    struct workload wl;
+    size_t *sizes, msg_size;
+    struct size_histogram hist;
+    int run;
+    struct run_stats msg_stats, thr_stats;
+
+    if (unix_socket_parse_options(&argc, argv) ||
+            payload_parse_options(&argc, argv) ||
+            bench_parse_options(&argc, argv) || argc != 3) {
+        printf("usage: unix_thr [options] <message-size> <message-count>\n"
+               "%s%s%s%s",
+               workload_usage(), unix_socket_usage(), payload_usage(),
+               bench_usage());
         return 1;
     }
 
-    size = atoi(argv[1]);
+    if (workload_parse(&wl, argv[1])) {
+        return 1;
+    }
+    size = wl.max_size;
     count = atol(argv[2]);
 
-    buf = malloc(size);
+    sizes = workload_sizes(&wl, count);
+    if (sizes == NULL) {
+        return 1;
+    }
+    size_histogram_reset(&hist);
+    for (bytes = 0, i = 0; i < count; i++) {
+        bytes += sizes[i];
+    }
+
+    if (run_stats_init(&msg_stats, "throughput", "msg/s", bench_opts.runs) ||
+            run_stats_init(&thr_stats, "throughput", "Mb/s",
+                           bench_opts.runs)) {
+        return 1;
+    }
+
+    buf = memory_alloc(sizeof(frame_header_t) + size);
     if (buf == NULL) {
-        perror("malloc");
         return 1;
     }
 
-    printf("message size: %i octets\n", size);
+    workload_print(&wl);
     printf("message count: %li\n", count);
 
-    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
-        perror("socketpair");
+    unix_socket_print();
+    payload_print();
+    if (unix_socket_pair(fds) || payload_init(wl.min_size)) {
+        return 1;
+    }
+    /* datagram and seqpacket sockets keep message boundaries themselves */
+    framed = unix_opts.type == SOCK_STREAM;
+
+    if (perf_counters_init(1)) {
         return 1;
     }
 
     if (!fork()) {
         /* child */
-
-        for (i = 0; i < count; i++) {
-            if (read(fds[1], buf, size) != size) {
-                perror("read");
-                return 1;
+        realtime_enter_peer();
+        perf_counters_open(1);
+        bench_prefault(buf, sizeof(frame_header_t) + size);
+
+        if (wl.kind == WORKLOAD_FIXED) {
+            for (i = 0; i < bench_peer_iterations(count); i++) {
+                perf_counters_peer_mark(i, count);
+                if (read_full(fds[1], buf, size)) {
+                    perror("read");
+                    return 1;
+                }
+                if (payload_verify) {
+                    payload_check(buf, size, i);
+                }
             }
+            perf_counters_stop();
+        } else {
+            for (i = 0; i < bench_peer_iterations(count); i++) {
+                perf_counters_peer_mark(i, count);
+                if (framed) {
+                    len = read_frame(fds[1], buf, size);
+                } else {
+                    len = read(fds[1], buf, size);
+                }
+                if (len != (ssize_t)sizes[i % count]) {
+                    perror("read");
+                    return 1;
+                }
+                if (payload_verify) {
+                    payload_check(framed ? buf + sizeof(frame_header_t) : buf,
+                                  len, i);
+                }
+            }
+            perf_counters_stop();
         }
     } else {
         /* parent */
+        bench_prefault(buf, sizeof(frame_header_t) + size);
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &start) == -1) {
-            perror("clock_gettime");
-            return 1;
-        }
-#else
-        if (gettimeofday(&start, NULL) == -1) {
-            perror("gettimeofday");
-            return 1;
-        }
-#endif
+        perf_counters_open(0);
+        for (run = bench_first_run(); run < bench_total_runs(); run++) {
+            if (run == bench_opts.warmup_runs) {
+                size_histogram_reset(&hist);
+                perf_counters_start();
+            }
+            start = now_ns();
+
+            if (wl.kind == WORKLOAD_FIXED) {
+                for (i = 0; bench_run_continues(run, i, count); i++) {
+                    if (payload_verify) {
+                        payload_fill(buf, size, seq++);
+                    }
+                    if (write(fds[0], buf, size) != size) {
+                        perror("write");
+                        return 1;
+                    }
+                }
+            } else {
+                for (i = 0; bench_run_continues(run, i, count); i++) {
+                    msg_size = sizes[bench_message_index(run, i, count)];
+                    if (payload_verify) {
+                        payload_fill(framed ? buf + sizeof(frame_header_t) : buf,
+                                     msg_size, seq++);
+                    }
+                    t0 = now_ns();
+                    if (framed ? write_frame(fds[0], buf, msg_size) :
+                            write(fds[0], buf, msg_size) != (ssize_t)msg_size) {
+                        perror("write");
+                        return 1;
+                    }
+                    size_histogram_add(&hist, msg_size, now_ns() - t0);
+                }
+            }
 
-        for (i = 0; i < count; i++) {
-            if (write(fds[0], buf, size) != size) {
-                perror("write");
-                return 1;
+            delta = now_ns() - start;
+            if (bench_warmup_done(run, i, delta)) {
+                continue;
             }
+            delta /= 1000;
+            run_stats_add(&msg_stats, run, (count * 1000000) / delta);
+            run_stats_add(&thr_stats, run, (bytes * 8) / delta);
         }
+        perf_counters_stop();
 
-#ifdef HAS_CLOCK_GETTIME_MONOTONIC
-        if (clock_gettime(CLOCK_MONOTONIC, &stop) == -1) {
-            perror("clock_gettime");
-            return 1;
+        run_stats_report(&msg_stats);
+        run_stats_report(&thr_stats);
+        if (wl.kind != WORKLOAD_FIXED) {
+            printf("per message send time by size:\n");
+            size_histogram_print(&hist, 1);
         }
-
-        delta = ((stop.tv_sec - start.tv_sec) * 1000000 +
-                 (stop.tv_nsec - start.tv_nsec) / 1000);
-
-#else
-        if (gettimeofday(&stop, NULL) == -1) {
-            perror("gettimeofday");
+        perf_counters_report("message", count * bench_opts.runs);
+        if (payload_report()) {
             return 1;
         }
-
-        delta =
-            (stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
-
-#endif
-
-        printf("average throughput: %li msg/s\n", (count * 1000000) / delta);
-        printf("average throughput: %li Mb/s\n",
-               (((count * 1000000) / delta) * size * 8) / 1000000);
     }
 
     return 0;
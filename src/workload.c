@@ -0,0 +1,356 @@
+/*
+    Message size workloads: fixed, uniform range or empirical distribution
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "workload.h"
+
+#include "stats.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define WORKLOAD_SEED 0x9e3779b97f4a7c15ULL
+
+static int parse_size(const char *s, char **end, size_t *out)
+{
+    unsigned long long v;
+
+    errno = 0;
+    v = strtoull(s, end, 10);
+    if (errno || *end == s) {
+        return -1;
+    }
+    *out = (size_t)v;
+    return 0;
+}
+
+static int load_empirical(struct workload *wl, const char *path)
+{
+    FILE *f;
+    char line[256];
+    size_t cap = 0;
+    double total = 0.0;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof line, f) != NULL) {
+        char *p = line, *end;
+        size_t size;
+        double weight = 1.0;
+
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '#' || *p == '\n' || *p == '\0') {
+            continue;
+        }
+        if (parse_size(p, &end, &size)) {
+            fprintf(stderr, "%s: bad line: %s", path, line);
+            fclose(f);
+            return -1;
+        }
+        p = end;
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+        if (*p != '\n' && *p != '\0' && *p != '#') {
+            weight = strtod(p, &end);
+            if (end == p || weight < 0.0) {
+                fprintf(stderr, "%s: bad weight: %s", path, line);
+                fclose(f);
+                return -1;
+            }
+        }
+
+        if (wl->nvalues == cap) {
+            cap = cap ? cap * 2 : 16;
+            wl->values = realloc(wl->values, cap * sizeof(*wl->values));
+            wl->cdf = realloc(wl->cdf, cap * sizeof(*wl->cdf));
+            if (wl->values == NULL || wl->cdf == NULL) {
+                perror("realloc");
+                fclose(f);
+                return -1;
+            }
+        }
+        total += weight;
+        wl->values[wl->nvalues] = size;
+        wl->cdf[wl->nvalues] = total;
+        wl->nvalues++;
+    }
+    fclose(f);
+
+    if (wl->nvalues == 0 || total <= 0.0) {
+        fprintf(stderr, "%s: empty size distribution\n", path);
+        return -1;
+    }
+
+    wl->min_size = wl->max_size = wl->values[0];
+    for (size_t i = 0; i < wl->nvalues; i++) {
+        wl->cdf[i] /= total;
+        if (wl->values[i] < wl->min_size) {
+            wl->min_size = wl->values[i];
+        }
+        if (wl->values[i] > wl->max_size) {
+            wl->max_size = wl->values[i];
+        }
+    }
+    return 0;
+}
+
+/* The length header of framed messages has to hold every size */
+static int check_max_size(struct workload *wl)
+{
+    if (wl->max_size > (frame_header_t)-1) {
+        fprintf(stderr, "message sizes are limited to %llu octets\n",
+                (unsigned long long)(frame_header_t)-1);
+        workload_free(wl);
+        return -1;
+    }
+    return 0;
+}
+
+int workload_parse(struct workload *wl, const char *spec)
+{
+    char *end;
+
+    memset(wl, 0, sizeof *wl);
+
+    if (strncmp(spec, "fixed:", 6) == 0) {
+        spec += 6;
+    }
+
+    if (strncmp(spec, "uniform:", 8) == 0) {
+        wl->kind = WORKLOAD_UNIFORM;
+        if (parse_size(spec + 8, &end, &wl->min_size) || *end != '-' ||
+                parse_size(end + 1, &end, &wl->max_size) || *end != '\0' ||
+                wl->min_size > wl->max_size) {
+            fprintf(stderr, "bad uniform workload: %s\n", spec);
+            return -1;
+        }
+        return check_max_size(wl);
+    }
+
+    if (strncmp(spec, "file:", 5) == 0) {
+        wl->kind = WORKLOAD_EMPIRICAL;
+        if (load_empirical(wl, spec + 5)) {
+            workload_free(wl);
+            return -1;
+        }
+        return check_max_size(wl);
+    }
+
+    wl->kind = WORKLOAD_FIXED;
+    if (parse_size(spec, &end, &wl->min_size) || *end != '\0') {
+        fprintf(stderr, "bad message size: %s\n", spec);
+        return -1;
+    }
+    wl->max_size = wl->min_size;
+    return check_max_size(wl);
+}
+
+void workload_free(struct workload *wl)
+{
+    free(wl->values);
+    free(wl->cdf);
+    wl->values = NULL;
+    wl->cdf = NULL;
+    wl->nvalues = 0;
+}
+
+void workload_print(const struct workload *wl)
+{
+    switch (wl->kind) {
+    case WORKLOAD_FIXED:
+        printf("message size: %zu octets\n", wl->min_size);
+        break;
+    case WORKLOAD_UNIFORM:
+        printf("message size: uniform %zu-%zu octets\n", wl->min_size,
+               wl->max_size);
+        break;
+    case WORKLOAD_EMPIRICAL:
+        printf("message size: empirical, %zu values, %zu-%zu octets\n",
+               wl->nvalues, wl->min_size, wl->max_size);
+        break;
+    }
+}
+
+const char *workload_usage(void)
+{
+    return "message size is either a fixed size in octets (\"256\"),\n"
+           "a uniform range (\"uniform:64-4096\") or an empirical\n"
+           "distribution file (\"file:sizes.txt\") with one\n"
+           "\"<size> [weight]\" pair per line\n";
+}
+
+size_t *workload_sizes(const struct workload *wl, int64_t count)
+{
+    uint64_t state = WORKLOAD_SEED;
+    size_t *sizes;
+
+    sizes = malloc((count > 0 ? count : 1) * sizeof(*sizes));
+    if (sizes == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+
+    for (int64_t i = 0; i < count; i++) {
+        uint64_t r = stats_random(&state);
+
+        switch (wl->kind) {
+        case WORKLOAD_FIXED:
+            sizes[i] = wl->min_size;
+            break;
+        case WORKLOAD_UNIFORM:
+            sizes[i] = wl->min_size + r % (wl->max_size - wl->min_size + 1);
+            break;
+        case WORKLOAD_EMPIRICAL: {
+            double u = (double)(r >> 11) / (double)(1ULL << 53);
+            size_t lo = 0, hi = wl->nvalues - 1;
+
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (wl->cdf[mid] <= u) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            sizes[i] = wl->values[lo];
+            break;
+        }
+        }
+    }
+    return sizes;
+}
+
+static int size_bucket(size_t size)
+{
+    int b = stats_bucket(size);
+
+    return b < SIZE_BUCKETS ? b : SIZE_BUCKETS - 1;
+}
+
+void size_histogram_reset(struct size_histogram *h)
+{
+    memset(h, 0, sizeof *h);
+}
+
+void size_histogram_add(struct size_histogram *h, size_t size, int64_t ns)
+{
+    int b = size_bucket(size);
+
+    h->msgs[b]++;
+    h->bytes[b] += size;
+    h->ns[b] += ns;
+}
+
+void size_histogram_print(const struct size_histogram *h, int div)
+{
+    printf("%24s %12s %14s %12s\n", "size bucket", "messages", "latency",
+           "throughput");
+    for (int b = 0; b < SIZE_BUCKETS; b++) {
+        char range[48];
+        int64_t ns;
+
+        if (h->msgs[b] == 0) {
+            continue;
+        }
+        stats_bucket_range(range, sizeof range, b);
+        ns = h->ns[b] > 0 ? h->ns[b] : 1;
+        printf("%24s %12li %11li ns %7li Mb/s\n", range, (long)h->msgs[b],
+               (long)(h->ns[b] / (h->msgs[b] * div)),
+               (long)((h->bytes[b] * div * 8 * 1000) / ns));
+    }
+}
+
+int read_full(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int write_full(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int write_frame(int fd, void *buf, size_t len)
+{
+    frame_header_t hdr = (frame_header_t)len;
+
+    memcpy(buf, &hdr, sizeof hdr);
+    return write_full(fd, buf, sizeof hdr + len);
+}
+
+ssize_t read_frame(int fd, void *buf, size_t max)
+{
+    frame_header_t hdr;
+
+    if (read_full(fd, &hdr, sizeof hdr)) {
+        return -1;
+    }
+    if (hdr > max) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (read_full(fd, (char *)buf + sizeof hdr, hdr)) {
+        return -1;
+    }
+    return hdr;
+}
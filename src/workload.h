@@ -0,0 +1,91 @@
+/*
+    Message size workloads: fixed, uniform range or empirical distribution
+
+
+    Copyright (c) 2016 Erik Rigtorp <erik@rigtorp.se>
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following
+    conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef IPC_BENCH_WORKLOAD_H
+#define IPC_BENCH_WORKLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+enum workload_kind {
+    WORKLOAD_FIXED,     /* "256" or "fixed:256" */
+    WORKLOAD_UNIFORM,   /* "uniform:64-4096" */
+    WORKLOAD_EMPIRICAL, /* "file:sizes.txt", lines of "<size> [weight]" */
+};
+
+struct workload {
+    enum workload_kind kind;
+    size_t min_size;
+    size_t max_size;
+
+    /* empirical distribution only */
+    size_t nvalues;
+    size_t *values;
+    double *cdf;
+};
+
+/* Stream transports prefix every variable sized message with its length */
+typedef uint32_t frame_header_t;
+
+#define SIZE_BUCKETS 64
+
+/* Per size bucket accounting, bucket n holds sizes in [2^(n-1), 2^n) */
+struct size_histogram {
+    int64_t msgs[SIZE_BUCKETS];
+    int64_t bytes[SIZE_BUCKETS];
+    int64_t ns[SIZE_BUCKETS];
+};
+
+/* Parse a workload spec, returns -1 and prints a diagnostic on error */
+int workload_parse(struct workload *wl, const char *spec);
+void workload_free(struct workload *wl);
+void workload_print(const struct workload *wl);
+const char *workload_usage(void);
+
+/* Draw count message sizes; the sequence is deterministic so a forked
+ * peer generating it again would see the same sizes */
+size_t *workload_sizes(const struct workload *wl, int64_t count);
+
+void size_histogram_reset(struct size_histogram *h);
+void size_histogram_add(struct size_histogram *h, size_t size, int64_t ns);
+/* Print per bucket message count, average time per message and bytes/s.
+ * The time of each entry is divided by div, e.g. 2 for round trips. */
+void size_histogram_print(const struct size_histogram *h, int div);
+
+/* Loop over short reads and writes, returns -1 on error or EOF */
+int read_full(int fd, void *buf, size_t len);
+int write_full(int fd, const void *buf, size_t len);
+
+/* Framed messages for byte stream transports. buf must have room for a
+ * frame_header_t in front of the payload, the payload starts right after it.
+ * read_frame returns the payload length or -1 on error. */
+int write_frame(int fd, void *buf, size_t len);
+ssize_t read_frame(int fd, void *buf, size_t max);
+
+#endif
@@ -0,0 +1,158 @@
+#!/bin/bash
+
+# Run every transport over a grid of message sizes, message counts and
+# child counts, repeat each point and write the median with a 95%
+# confidence interval to <prefix>.csv and <prefix>.json.
+
+set -e
+
+SIZES="1 4 16 64 256 1024 4096 16384 65536 262144 1048576 4194304 16777216"
+COUNTS="10000"
+CHILDREN="1 4 16"
+REPS=5
+TRANSPORTS="pipe_lat unix_lat tcp_lat udp_lat sysv_msgqueue posix_msgqueue
+            sysv_msgqueue_multi sysv_semaphore sysv_semaphore_multi
+            posix_sharedmem posix_sharedmem_multi pipe_thr unix_thr tcp_thr"
+# Upper bound of octets moved per data point, large messages get fewer
+# iterations so a full sweep finishes in reasonable time
+BYTES_BUDGET=$((1 << 30))
+PREFIX=sweep
+SWEEP_OPTIONS='s SIZES "<sizes>" message sizes in octets (default: 1B to 16MB)
+c COUNTS "<counts>" message/roundtrip counts
+k CHILDREN "<children>" child counts for the *_multi benchmarks
+r REPS <reps> repetitions per point
+t TRANSPORTS "<transports>" benchmarks to run (default: all)
+b BYTES_BUDGET <octets> per point data budget capping the count
+o PREFIX <prefix> output file prefix'
+
+. "$(dirname "$0")/sweep_lib.sh"
+sweep_parse_options "$@"
+OUT=$(sweep_path "$PREFIX")
+
+sweep_build
+
+# Kernel limits on message sizes, bigger points are skipped
+SYSV_MSGMAX=$(cat /proc/sys/kernel/msgmax 2>/dev/null || echo 8192)
+POSIX_MSGMAX=$(cat /proc/sys/fs/mqueue/msgsize_max 2>/dev/null || echo 8192)
+UDP_MAX=65507
+
+max_size() {
+    case $1 in
+    sysv_msgqueue*) echo "$SYSV_MSGMAX" ;;
+    posix_msgqueue) echo "$POSIX_MSGMAX" ;;
+    udp_lat) echo "$UDP_MAX" ;;
+    *) echo 0 ;;
+    esac
+}
+
+# Benchmark command line for a point: transport size count children
+command_line() {
+    case $1 in
+    sysv_semaphore | posix_sharedmem) echo "./$1 $3" ;;
+    sysv_semaphore_multi | posix_sharedmem_multi) echo "./$1 $3 $4" ;;
+    sysv_msgqueue_multi) echo "./$1 $2 $3 $4" ;;
+    *) echo "./$1 $2 $3" ;;
+    esac
+}
+
+uses_size() {
+    case $1 in
+    sysv_semaphore* | posix_sharedmem*) return 1 ;;
+    *) return 0 ;;
+    esac
+}
+
+uses_children() {
+    case $1 in
+    *_multi) return 0 ;;
+    *) return 1 ;;
+    esac
+}
+
+# Reads one value per line, prints "n median ci_low ci_high". The interval
+# is the distribution free order statistic interval of the median.
+summarize() {
+    sort -g | awk '
+        { v[NR] = $1 }
+        END {
+            n = NR
+            if (n == 0) { exit }
+            if (n % 2) { med = v[(n + 1) / 2] } else { med = (v[n / 2] + v[n / 2 + 1]) / 2 }
+            h = 1.96 * sqrt(n) / 2
+            lo = int(n / 2 - h); if (lo < 1) lo = 1
+            hi = int(n / 2 + 1 + h + 0.999); if (hi > n) hi = n
+            printf "%d %.10g %.10g %.10g\n", n, med, v[lo], v[hi]
+        }'
+}
+
+CSV=$OUT.csv
+JSON=$OUT.json
+echo "transport,metric,unit,size,count,children,runs,median,ci_low,ci_high" > "$CSV"
+echo "[" > "$JSON"
+first=1
+
+record() {
+    # transport metric unit size count children values...
+    local t=$1 metric=$2 unit=$3 size=$4 count=$5 children=$6 values=$7
+    local stats
+    stats=$(printf "%s" "$values" | summarize)
+    [ -n "$stats" ] || return 0
+    set -- $stats
+    echo "$t,$metric,$unit,$size,$count,$children,$1,$2,$3,$4" >> "$CSV"
+    [ $first -eq 1 ] || echo "," >> "$JSON"
+    first=0
+    printf '  {"transport": "%s", "metric": "%s", "unit": "%s", "size": %s, "count": %s, "children": %s, "runs": %s, "median": %s, "ci_low": %s, "ci_high": %s}' \
+        "$t" "$metric" "$unit" "$size" "$count" "$children" "$1" "$2" "$3" "$4" >> "$JSON"
+}
+
+run_point() {
+    local t=$1 size=$2 count=$3 children=$4
+    local n=$count lat="" thr="" out
+
+    if uses_size "$t"; then
+        local budget=$((BYTES_BUDGET / (size > 0 ? size : 1)))
+        [ "$budget" -ge 10 ] || budget=10
+        [ "$n" -le "$budget" ] || n=$budget
+    fi
+
+    printf "%-22s size=%-9s count=%-7s children=%-3s" "$t" "$size" "$n" "$children"
+    for ((rep = 0; rep < REPS; rep++)); do
+        if ! out=$($(command_line "$t" "$size" "$n" "$children") 2> /dev/null); then
+            printf " failed\n"
+            return 0
+        fi
+        lat+=$(printf "%s\n" "$out" | awk '/^average latency:/ { print $3 }')$'\n'
+        thr+=$(printf "%s\n" "$out" | awk '/^average throughput:.*Mb\/s/ { print $3 }')$'\n'
+    done
+    printf " done\n"
+
+    lat=$(printf "%s" "$lat" | sed '/^$/d')
+    thr=$(printf "%s" "$thr" | sed '/^$/d')
+    [ -z "$lat" ] || record "$t" latency ns "$size" "$n" "$children" "$lat"
+    [ -z "$thr" ] || record "$t" throughput Mb/s "$size" "$n" "$children" "$thr"
+}
+
+for t in $TRANSPORTS; do
+    if [[ "$OSTYPE" == "darwin"* ]] && [[ $t == posix_* ]]; then
+        continue
+    fi
+    limit=$(max_size "$t")
+    sizes=$SIZES
+    uses_size "$t" || sizes=0
+    children_list=1
+    uses_children "$t" && children_list=$CHILDREN
+
+    for size in $sizes; do
+        if [ "$limit" -gt 0 ] && [ "$size" -gt "$limit" ]; then
+            continue
+        fi
+        for count in $COUNTS; do
+            for children in $children_list; do
+                run_point "$t" "$size" "$count" "$children"
+            done
+        done
+    done
+done
+
+printf "\n]\n" >> "$JSON"
+printf "\nwrote %s and %s\n" "$CSV" "$JSON"
@@ -0,0 +1,67 @@
+# Helpers shared by the sweep scripts. Source this after setting the
+# defaults and SWEEP_OPTIONS, one option per line:
+#
+#     <letter> <VARIABLE> <argument> <description>
+#
+# Descriptions get "(default: $VARIABLE)" appended unless they name their
+# own default.
+
+sweep_usage() {
+    local letter var arg desc
+
+    echo "usage: $(basename "$0") [options]"
+    while read -r letter var arg desc; do
+        [[ $desc == *"(default"* ]] || desc+=" (default: ${!var})"
+        printf "  -%s %-16s %s\n" "$letter" "$arg" "$desc"
+    done <<< "$SWEEP_OPTIONS"
+    exit 1
+}
+
+# Set the variables of SWEEP_OPTIONS from the command line
+sweep_parse_options() {
+    local spec="" letter var arg desc opt
+
+    while read -r letter var arg desc; do
+        spec+="$letter:"
+    done <<< "$SWEEP_OPTIONS"
+    while getopts "${spec}h" opt; do
+        [ "$opt" != "?" ] && [ "$opt" != h ] || sweep_usage
+        while read -r letter var arg desc; do
+            [ "$letter" != "$opt" ] || printf -v "$var" "%s" "$OPTARG"
+        done <<< "$SWEEP_OPTIONS"
+    done
+}
+
+# Output paths are taken relative to where the script was started
+sweep_path() {
+    case $1 in
+    /*) echo "$1" ;;
+    *) echo "$(pwd)/$1" ;;
+    esac
+}
+
+# Build the given targets, or all, and change into the build directory
+sweep_build() {
+    mkdir -p build
+    cd build
+    cmake .. > /dev/null
+    make "$@" > /dev/null
+}
+
+# Value of a metric in benchmark output on stdin, pattern being what
+# follows "median " or "average ", e.g. "latency:" or "throughput:.*Mb/s".
+# The median over the runs if there is one, the average of a single run
+# otherwise.
+sweep_metric() {
+    awk -v p="$1" '
+        $0 ~ "^median " p { sub(/^[^:]*: */, ""); m = $1 }
+        $0 ~ "^average " p && a == "" { sub(/^[^:]*: */, ""); a = $1 }
+        END { print (m != "" ? m : a) }'
+}
+
+# Relative change of a value against a base, "-" if either is missing
+sweep_change() {
+    awk -v v="$1" -v b="$2" 'BEGIN {
+        if (v == "" || b == "" || b == 0) { print "-" } else { printf "%+.1f%%", (v - b) * 100 / b }
+    }'
+}
@@ -0,0 +1,69 @@
+#!/bin/bash
+
+# Run tcp_lat and tcp_thr over loopback with one TCP socket option
+# setting at a time and report the median latency and throughput of each
+# relative to the default settings.
+
+set -e
+
+SIZES="64 1024 16384"
+COUNT=20000
+RUNS=5
+OUT=tcp_matrix.csv
+# One setting per line. Corked segments wait for the 200ms timer when a
+# roundtrip leaves a partial segment, so cork is measured for throughput
+# only.
+SETTINGS="default
+--nodelay
+--nodelay=0
+--quickack
+--nodelay --quickack
+--cork
+--busy-poll=50
+--sndbuf=65536 --rcvbuf=65536
+--sndbuf=4194304 --rcvbuf=4194304
+--notsent-lowat=16384
+--so-priority=6"
+SWEEP_OPTIONS='s SIZES "<sizes>" message sizes in octets
+c COUNT <count> messages/roundtrips per run
+r RUNS <runs> measured runs per point
+o OUT <file> csv output'
+
+. "$(dirname "$0")/sweep_lib.sh"
+sweep_parse_options "$@"
+OUT=$(sweep_path "$OUT")
+
+sweep_build tcp_lat tcp_thr
+
+# Result of a benchmark: binary options size metric-pattern
+measure() {
+    ./$1 --runs="$RUNS" $2 "$3" "$COUNT" 2> /dev/null | sweep_metric "$4"
+}
+
+echo "options,size,latency_ns,throughput_mbps,latency_change,throughput_change" > "$OUT"
+printf "%-34s %-7s %10s %8s %12s %8s\n" options size "lat (ns)" change "thr (Mb/s)" change
+
+for size in $SIZES; do
+    base_lat=""
+    base_thr=""
+    while read -r setting; do
+        opts=$setting
+        [ "$setting" != default ] || opts=""
+
+        lat=""
+        [[ $setting == *--cork* ]] || lat=$(measure tcp_lat "$opts" "$size" "latency:")
+        thr=$(measure tcp_thr "$opts" "$size" "throughput:.*Mb/s")
+        if [ "$setting" = default ]; then
+            base_lat=$lat
+            base_thr=$thr
+        fi
+        lat_change=$(sweep_change "$lat" "$base_lat")
+        thr_change=$(sweep_change "$thr" "$base_thr")
+
+        echo "\"$setting\",$size,$lat,$thr,$lat_change,$thr_change" >> "$OUT"
+        printf "%-34s %-7s %10s %8s %12s %8s\n" "$setting" "$size" "${lat:--}" \
+            "$lat_change" "${thr:--}" "$thr_change"
+    done <<< "$SETTINGS"
+done
+
+printf "\nwrote %s\n" "$OUT"
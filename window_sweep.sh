@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# Run the latency benchmarks with a growing window of requests in flight
+# and report throughput and round trip latency at each window.
+
+set -e
+
+BENCHMARKS="pipe_lat unix_lat tcp_lat udp_lat sysv_msgqueue posix_msgqueue"
+WINDOWS="1 2 4 8 16 32 64"
+SIZE=64
+COUNT=20000
+RUNS=5
+OUT=window_sweep.csv
+SWEEP_OPTIONS='b BENCHMARKS "<benchmarks>" latency benchmarks
+w WINDOWS "<windows>" requests in flight
+s SIZE <size> message size in octets
+c COUNT <count> roundtrips per run
+r RUNS <runs> measured runs per point
+o OUT <file> csv output'
+
+. "$(dirname "$0")/sweep_lib.sh"
+sweep_parse_options "$@"
+OUT=$(sweep_path "$OUT")
+
+sweep_build $BENCHMARKS
+
+echo "benchmark,window,latency_ns,throughput_rtps,p50_ns,p99_ns" > "$OUT"
+printf "%-16s %6s %12s %14s %10s %10s\n" benchmark window "lat (ns)" \
+    "thr (rt/s)" "p50 (ns)" "p99 (ns)"
+
+for bench in $BENCHMARKS; do
+    # without it Nagle holds back every request after the first
+    options=""
+    [ "$bench" != tcp_lat ] || options=--nodelay
+    for window in $WINDOWS; do
+        # windows that do not fit into the transport's buffers are
+        # rejected, skip them
+        result=$(./$bench $options --runs="$RUNS" --window="$window" \
+                     "$SIZE" "$COUNT" 2> /dev/null || true)
+        [ -n "$result" ] || continue
+        lat=$(echo "$result" | sweep_metric "latency:")
+        thr=$(echo "$result" | sweep_metric "throughput:.*roundtrip")
+        # percentiles over all requests, which are only timed one by one
+        # with a window; without one the rate follows from the latency
+        echo "$result" | awk -v b="$bench" -v w="$window" -v out="$OUT" \
+                             -v lat="$lat" -v thr="$thr" '
+            /^round trip percentiles:/ {
+                gsub(",", ""); p50 = $5; p99 = $9
+            }
+            END {
+                if (lat == "") { exit }
+                if (thr == "") { thr = int(1e9 / (2 * lat)) }
+                if (p50 == "") { p50 = "-"; p99 = "-" }
+                printf "%s,%s,%s,%s,%s,%s\n", b, w, lat, thr, p50, p99 >> out
+                printf "%-16s %6s %12s %14s %10s %10s\n", b, w, lat, thr, p50, p99
+            }'
+    done
+done
+
+printf "\nwrote %s\n" "$OUT"